@@ -0,0 +1,103 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 重複使用的位元組緩衝區：讀檔用的大區塊不必每個檔案重新配置、重新觸發 page fault
+// 緩衝區不清零；歸還時池中已滿就直接釋放
+class BufferPool {
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> bytes;
+        size_t capacity = 0;
+    };
+
+    struct Shared {
+        std::mutex mutex;
+        std::vector<Block> blocks;
+        size_t maxBlocks;
+    };
+
+public:
+    // 借出的緩衝區，解構時歸還給池 (池本身先解構也沒關係)
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&&) noexcept = default;
+        Buffer& operator=(Buffer&& other) noexcept {
+            if (this != &other) {
+                release();
+                block = std::move(other.block);
+                length = other.length;
+                shared = std::move(other.shared);
+            }
+            return *this;
+        }
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        ~Buffer() { release(); }
+
+        uint8_t* data() { return block.bytes.get(); }
+        const uint8_t* data() const { return block.bytes.get(); }
+        size_t size() const { return length; }
+
+        // 實際讀到的長度比申請時短 (例如讀檔途中被截斷)
+        void shrink(size_t newSize) { length = std::min(length, newSize); }
+
+        void release() {
+            if (shared && block.bytes) {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                if (shared->blocks.size() < shared->maxBlocks) {
+                    shared->blocks.push_back(std::move(block));
+                }
+            }
+            block = Block();
+            length = 0;
+            shared.reset();
+        }
+
+    private:
+        friend class BufferPool;
+        Block block;
+        size_t length = 0;
+        std::shared_ptr<Shared> shared;
+    };
+
+    explicit BufferPool(size_t maxBlocks = 16) : shared(std::make_shared<Shared>()) {
+        shared->maxBlocks = maxBlocks;
+    }
+
+    // 取池中容量足夠的最小區塊，沒有時配置新的
+    Buffer acquire(size_t size) {
+        Buffer buffer;
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            auto& blocks = shared->blocks;
+            auto best = blocks.end();
+            for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+                if (it->capacity >= size && (best == blocks.end() || it->capacity < best->capacity)) best = it;
+            }
+            if (best != blocks.end()) {
+                buffer.block = std::move(*best);
+                blocks.erase(best);
+            }
+        }
+        if (!buffer.block.bytes) {
+            buffer.block.bytes.reset(new uint8_t[std::max<size_t>(size, 1)]);
+            buffer.block.capacity = std::max<size_t>(size, 1);
+        }
+        buffer.length = size;
+        buffer.shared = shared;
+        return buffer;
+    }
+
+private:
+    std::shared_ptr<Shared> shared;
+};
+
+#endif // BUFFER_POOL_H
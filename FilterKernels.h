@@ -0,0 +1,31 @@
+#ifndef FILTER_KERNELS_H
+#define FILTER_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 影像中一塊矩形區域的像素視圖，座標為該區域在整張影像中的位置
+struct PixelRegion {
+    uint8_t* data;  // 區域左上角像素
+    size_t stride;  // 每列位元組數
+    int x, y;       // 區域左上角在影像中的座標
+    int width, height;
+    int channels;
+
+    uint8_t* row(int imageY) const { return data + static_cast<size_t>(imageY - y) * stride; }
+    uint8_t* pixel(int imageX, int imageY) const { return row(imageY) + static_cast<size_t>(imageX - x) * channels; }
+};
+
+// 單列像素核心 (count 為位元組數，pixels 為像素數)，src 與 dst 可以是同一塊記憶體
+void grayscaleRow(const uint8_t* src, uint8_t* dst, int pixels, int channels, bool singleChannel);
+void invertRow(const uint8_t* src, uint8_t* dst, size_t count);
+void brightnessRow(const uint8_t* src, uint8_t* dst, size_t count, int brightness);
+void contrastRow(const uint8_t* src, uint8_t* dst, size_t count, float contrast);
+void saturationRow(const uint8_t* src, uint8_t* dst, int pixels, int channels, float saturation);
+void colorTemperatureRow(const uint8_t* src, uint8_t* dst, int pixels, int channels, int temperature);
+
+// 模糊核心：計算 dst 區域，鄰近像素的座標限制在影像範圍內
+// src 必須涵蓋 dst 向外擴展 radius 後與影像範圍的交集
+void blurRegion(const PixelRegion& src, const PixelRegion& dst, int radius, int imageWidth, int imageHeight);
+
+#endif // FILTER_KERNELS_H
@@ -0,0 +1,101 @@
+#include "ImageCache.h"
+#include "RawImage.h"
+#include "Trace.h"
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // 快取檔名取路徑的雜湊；碰撞時檔頭內記錄的完整路徑不符，只會當成未命中
+    std::string entryName(const std::string& sourcePath) {
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << std::hash<std::string>()(sourcePath) << ".raw";
+        return name.str();
+    }
+
+    bool sameSource(const rawimage::SourceKey& a, const rawimage::SourceKey& b) {
+        return a.path == b.path && a.size == b.size && a.mtime == b.mtime;
+    }
+}
+
+bool ImageCache::sourceKey(const std::string& filename, rawimage::SourceKey& key) {
+    std::error_code ec;
+    const fs::path path = fs::absolute(filename, ec);
+    if (ec) return false;
+    const uintmax_t size = fs::file_size(path, ec);
+    if (ec) return false;
+    const fs::file_time_type mtime = fs::last_write_time(path, ec);
+    if (ec) return false;
+    key.path = path.lexically_normal().string();
+    key.size = static_cast<uint64_t>(size);
+    key.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    return true;
+}
+
+ImageCache::ImageCache(std::string directory) : directory(std::move(directory)) {
+}
+
+std::string ImageCache::defaultDirectory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        if (*xdg) return (fs::path(xdg) / "paranoma").string();
+    }
+    if (const char* home = std::getenv("HOME")) {
+        if (*home) return (fs::path(home) / ".cache" / "paranoma").string();
+    }
+    std::error_code ec;
+    const fs::path temp = fs::temp_directory_path(ec);
+    return ec ? std::string("paranoma-cache") : (temp / "paranoma").string();
+}
+
+Image ImageCache::load(const std::string& filename, const ExecutionContext& ctx) const {
+    // key 在解碼前取得，解碼期間來源被替換時 store 會發現不符而不寫入
+    rawimage::SourceKey key;
+    const bool keyed = sourceKey(filename, key);
+    std::optional<Image> cached;
+    if (keyed && find(key, cached)) {
+        return std::move(*cached);
+    }
+    Image img = Image::loadFromJPG(filename, ctx); // 來源不存在時由解碼器回報錯誤
+    if (keyed) store(key, img);
+    return img;
+}
+
+bool ImageCache::find(const std::string& filename, std::optional<Image>& image) const {
+    rawimage::SourceKey key;
+    return sourceKey(filename, key) && find(key, image);
+}
+
+bool ImageCache::find(const rawimage::SourceKey& key, std::optional<Image>& image) const {
+    TRACE_SCOPE("ImageCache::find");
+    const fs::path entry = fs::path(directory) / entryName(key.path);
+    std::shared_ptr<const MappedFile> file = MappedFile::open(entry.string());
+    if (!file || !rawimage::matches(*file, key)) return false;
+    image.emplace(Image::fromMapping(std::move(file)));
+    return true;
+}
+
+void ImageCache::store(const rawimage::SourceKey& key, const Image& image) const {
+    TRACE_SCOPE("ImageCache::store");
+    rawimage::SourceKey current;
+    if (!sourceKey(key.path, current) || !sameSource(current, key)) return;
+
+    // 先寫到暫存檔再改名，同時載入同一張圖的其他執行緒或行程不會讀到寫一半的檔案
+    const fs::path entry = fs::path(directory) / entryName(key.path);
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    std::ostringstream suffix;
+    suffix << ".tmp" << std::hex << std::random_device()();
+    const fs::path temp = entry.string() + suffix.str();
+    const bool stored = !ec && rawimage::write(temp.string(), image, &key);
+    if (stored) {
+        fs::rename(temp, entry, ec);
+    }
+    if (!stored || ec) {
+        fs::remove(temp, ec);
+    }
+}
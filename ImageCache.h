@@ -0,0 +1,39 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <optional>
+#include <string>
+#include "Image.h"
+#include "RawImage.h"
+
+// 解碼結果的磁碟快取：以來源的絕對路徑、修改時間與大小為 key，存成可直接映射的原始像素檔
+// 命中時不解碼也不複製像素；來源變更後自動重新解碼並覆寫
+class ImageCache {
+private:
+    std::string directory;
+
+public:
+    explicit ImageCache(std::string directory = defaultDirectory());
+
+    // $XDG_CACHE_HOME/paranoma、~/.cache/paranoma 或系統暫存目錄下的 paranoma
+    static std::string defaultDirectory();
+
+    // 命中時回傳映射的影像，否則以 Image::loadFromJPG 解碼並寫入快取 (寫入失敗不影響結果)
+    Image load(const std::string& filename,
+               const ExecutionContext& ctx = ExecutionContext::defaultContext()) const;
+
+    // 來源目前的絕對路徑、大小與修改時間，取不到時回傳 false
+    // 必須在讀取來源之前取得，解碼完成後交給 store
+    static bool sourceKey(const std::string& filename, rawimage::SourceKey& key);
+
+    // 只查詢：命中時填入映射的影像並回傳 true
+    bool find(const std::string& filename, std::optional<Image>& image) const;
+    bool find(const rawimage::SourceKey& key, std::optional<Image>& image) const;
+
+    // 把依 key 描述的來源解碼好的影像寫入快取；來源在解碼期間被替換 (key 已不符) 時不寫入，失敗時忽略
+    void store(const rawimage::SourceKey& key, const Image& image) const;
+
+    const std::string& getDirectory() const { return directory; }
+};
+
+#endif // IMAGE_CACHE_H
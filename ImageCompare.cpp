@@ -0,0 +1,32 @@
+#include "ImageCompare.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+ImageDifference compareImages(const Image& expected, const Image& actual) {
+    ImageDifference diff;
+    diff.sameShape = expected.getWidth() == actual.getWidth() &&
+        expected.getHeight() == actual.getHeight() &&
+        expected.getChannels() == actual.getChannels();
+    if (!diff.sameShape) return diff;
+
+    const uint8_t* a = expected.pixels();
+    const uint8_t* b = actual.pixels();
+    const size_t count = expected.byteSize();
+    uint64_t absoluteSum = 0;
+    uint64_t squaredSum = 0;
+    for (size_t i = 0; i < count; i++) {
+        const int error = std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i]));
+        if (error == 0) continue;
+        diff.mismatched++;
+        diff.maxError = std::max(diff.maxError, error);
+        absoluteSum += error;
+        squaredSum += static_cast<uint64_t>(error) * error;
+    }
+
+    diff.meanError = count > 0 ? static_cast<double>(absoluteSum) / count : 0.0;
+    diff.psnr = squaredSum == 0 ? std::numeric_limits<double>::infinity()
+                                : 10.0 * std::log10(255.0 * 255.0 * count / squaredSum);
+    return diff;
+}
@@ -0,0 +1,22 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <cstddef>
+#include "Image.h"
+
+// 兩張影像逐位元組的差異
+struct ImageDifference {
+    bool sameShape = false; // 寬、高、通道數相同；不同時其餘欄位無意義
+    int maxError = 0;       // 最大絕對誤差
+    double meanError = 0;   // 平均絕對誤差
+    double psnr = 0;        // 峰值訊噪比 (dB)，完全相同時為無限大
+    size_t mismatched = 0;  // 不相同的位元組數
+
+    bool identical() const { return sameShape && mismatched == 0; }
+    // 形狀相同且最大誤差不超過 tolerance
+    bool within(int tolerance) const { return sameShape && maxError <= tolerance; }
+};
+
+ImageDifference compareImages(const Image& expected, const Image& actual);
+
+#endif // IMAGE_COMPARE_H
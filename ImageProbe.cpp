@@ -0,0 +1,31 @@
+#include "ImageProbe.h"
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// 每個檔案只讀數 KB，成本主要是開檔與磁碟延遲
+std::vector<ProbedImage> probeImages(const std::vector<std::string>& paths, const ExecutionContext& ctx) {
+    std::vector<ProbedImage> results(paths.size());
+    parallelFor(ctx, 0, static_cast<int>(paths.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            results[i].path = paths[i];
+            results[i].ok = Image::probe(paths[i], results[i].info);
+        }
+    });
+    return results;
+}
+
+std::vector<ProbedImage> probeDirectory(const std::string& directory, const ExecutionContext& ctx) {
+    std::vector<std::string> paths;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<ProbedImage> results = probeImages(paths, ctx);
+    results.erase(std::remove_if(results.begin(), results.end(), [](const ProbedImage& p) { return !p.ok; }), results.end());
+    return results;
+}
@@ -0,0 +1,23 @@
+#ifndef IMAGE_PROBE_H
+#define IMAGE_PROBE_H
+
+#include <string>
+#include <vector>
+#include "Image.h"
+
+// 批次排程前的檔頭探測結果
+struct ProbedImage {
+    std::string path;
+    ImageInfo info;
+    bool ok = false; // 無法辨識或讀取失敗時為 false
+};
+
+// 平行探測每個檔案的檔頭，結果與 paths 順序相同
+std::vector<ProbedImage> probeImages(const std::vector<std::string>& paths,
+                                     const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+// 探測目錄下 (不含子目錄) 的所有一般檔案，只回傳可辨識的影像，依路徑排序
+std::vector<ProbedImage> probeDirectory(const std::string& directory,
+                                        const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+#endif // IMAGE_PROBE_H
@@ -1,162 +1,566 @@
 #include "ImageProcessing.h"
+#include "FilterKernels.h"
+#include "TileExecutor.h"
+#include "Pipeline.h"
+#include "Trace.h"
+#include "IntegralImage.h"
 #include <vector>
 #include <cmath>
 #include <algorithm>
 #include <iostream>
 #include <cstdint>
-#include <omp.h>
+#include <limits>
 
 
-// 灰階轉換
-Image applyGrayscale(const Image& img) {
-    Image result(img.getWidth(), img.getHeight(), img.getChannels());
-    const auto& srcData = img.getData();
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
+// 灰階權重 (Q15 定點數，0.299 / 0.587 / 0.114，總和為 32768)
+static const int kGrayWeightR = 9798;
+static const int kGrayWeightG = 19235;
+static const int kGrayWeightB = 3735;
 
-    if (img.getChannels() < 3) return img; // 不處理少於 3 通道的影像
+static inline uint8_t grayFromRGB(int r, int g, int b) {
+    return static_cast<uint8_t>((r * kGrayWeightR + g * kGrayWeightG + b * kGrayWeightB) >> 15);
+}
 
-    for (int i = 0; i < img.getWidth() * img.getHeight(); i++) {
-        uint8_t r = srcData[i * img.getChannels()];
-        uint8_t g = srcData[i * img.getChannels() + 1];
-        uint8_t b = srcData[i * img.getChannels() + 2];
-        uint8_t gray = static_cast<uint8_t>(0.299 * r + 0.587 * g + 0.114 * b);
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IMAGE_PROCESSING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define IMAGE_PROCESSING_TARGET_SSSE3
+#else
+#define IMAGE_PROCESSING_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+static bool cpuHasSSSE3() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
 
-        destData[i * img.getChannels()] = gray;
-        destData[i * img.getChannels() + 1] = gray;
-        destData[i * img.getChannels() + 2] = gray;
+// 8 個像素的 R/G/B (16 位元) 計算灰階 (32 位元結果壓回 16 位元)
+static inline __m128i grayFromRGB16(__m128i r, __m128i g, __m128i b) {
+    const __m128i weightsRG = _mm_set1_epi32((kGrayWeightG << 16) | kGrayWeightR);
+    const __m128i weightsB = _mm_set1_epi32(kGrayWeightB);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), weightsRG),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(b, zero), weightsB));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), weightsRG),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(b, zero), weightsB));
+    return _mm_packs_epi32(_mm_srli_epi32(lo, 15), _mm_srli_epi32(hi, 15));
+}
 
-        if (img.getChannels() == 4) { // 保持 alpha 通道
-            destData[i * img.getChannels() + 3] = srcData[i * img.getChannels() + 3];
+// RGB 每次處理 16 個像素：pshufb 拆出 R/G/B 平面，回傳已處理的像素數
+IMAGE_PROCESSING_TARGET_SSSE3
+static int grayscaleRowRGB_SSSE3(const uint8_t* src, uint8_t* dst, int width, bool singleChannel) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rA = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i rB = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i rC = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i gA = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i gB = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i gC = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i bA = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i bB = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i bC = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+    const __m128i out0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i out1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i out2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8_t* p = src + x * 3;
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+
+        __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, rA), _mm_shuffle_epi8(b, rB)), _mm_shuffle_epi8(c, rC));
+        __m128i g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, gA), _mm_shuffle_epi8(b, gB)), _mm_shuffle_epi8(c, gC));
+        __m128i bl = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, bA), _mm_shuffle_epi8(b, bB)), _mm_shuffle_epi8(c, bC));
+
+        __m128i grayLo = grayFromRGB16(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(bl, zero));
+        __m128i grayHi = grayFromRGB16(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(bl, zero));
+        __m128i gray = _mm_packus_epi16(grayLo, grayHi);
+
+        if (singleChannel) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), gray);
+        } else {
+            uint8_t* q = dst + x * 3;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(q), _mm_shuffle_epi8(gray, out0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(q + 16), _mm_shuffle_epi8(gray, out1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(q + 32), _mm_shuffle_epi8(gray, out2));
         }
     }
-    return result;
+    return x;
 }
 
-// 模糊處理
-Image applyBlur(const Image& img, int radius) {
-    if (radius <= 0) return img;
+// RGBA 每次處理 16 個像素 (每個向量 4 個)：以 16 位元遮罩拆成 (R,B) 與 (G,A) 兩組後 madd，回傳已處理的像素數
+static int grayscaleRowRGBA_SSE2(const uint8_t* src, uint8_t* dst, int width, bool singleChannel) {
+    const __m128i lowByte = _mm_set1_epi16(0x00FF);
+    const __m128i weightsRB = _mm_set1_epi32((kGrayWeightB << 16) | kGrayWeightR);
+    const __m128i weightsG = _mm_set1_epi32(kGrayWeightG);
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i gray[4];
+        for (int k = 0; k < 4; k++) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (x + k * 4) * 4));
+            __m128i rb = _mm_and_si128(v, lowByte);
+            __m128i ga = _mm_srli_epi16(v, 8);
+            gray[k] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(rb, weightsRB), _mm_madd_epi16(ga, weightsG)), 15);
+
+            if (!singleChannel) {
+                __m128i g = gray[k];
+                __m128i px = _mm_or_si128(_mm_or_si128(g, _mm_slli_epi32(g, 8)), _mm_slli_epi32(g, 16));
+                px = _mm_or_si128(px, _mm_and_si128(v, alphaMask));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (x + k * 4) * 4), px);
+            }
+        }
+        if (singleChannel) {
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(gray[0], gray[1]), _mm_packs_epi32(gray[2], gray[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+        }
+    }
+    return x;
+}
+#endif
+
+// 單列灰階轉換，dst 為單通道或與 src 相同通道數
+void grayscaleRow(const uint8_t* src, uint8_t* dst, int width, int channels, bool singleChannel) {
+    int x = 0;
+#ifdef IMAGE_PROCESSING_X86
+    static const bool hasSSSE3 = cpuHasSSSE3();
+    if (channels == 3 && hasSSSE3) {
+        x = grayscaleRowRGB_SSSE3(src, dst, width, singleChannel);
+    }
+    else if (channels == 4) {
+        x = grayscaleRowRGBA_SSE2(src, dst, width, singleChannel);
+    }
+#endif
+    for (; x < width; x++) {
+        const uint8_t* p = src + x * channels;
+        uint8_t gray = grayFromRGB(p[0], p[1], p[2]);
+        if (singleChannel) {
+            dst[x] = gray;
+            continue;
+        }
+        uint8_t* q = dst + x * channels;
+        q[0] = gray;
+        q[1] = gray;
+        q[2] = gray;
+        if (channels == 4) { // 保持 alpha 通道
+            q[3] = p[3];
+        }
+    }
+}
 
-    Image result(img.getWidth(), img.getHeight(), img.getChannels());
-    const auto& srcData = img.getData();
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
+void invertRow(const uint8_t* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = 255 - src[i];
+    }
+}
+
+void brightnessRow(const uint8_t* src, uint8_t* dst, size_t count, int brightness) {
+    for (size_t i = 0; i < count; i++) {
+        int adjusted = static_cast<int>(src[i]) + brightness;
+        dst[i] = (adjusted < 0) ? 0 : (adjusted > 255 ? 255 : adjusted); // 手動 clamp
+    }
+}
+
+void contrastRow(const uint8_t* src, uint8_t* dst, size_t count, float contrast) {
+    for (size_t i = 0; i < count; i++) {
+        int adjusted = static_cast<int>(128 + (src[i] - 128) * contrast);
+        dst[i] = (adjusted < 0) ? 0 : (adjusted > 255 ? 255 : adjusted); // 手動 clamp
+    }
+}
 
-    int size = 2 * radius + 1;
+void saturationRow(const uint8_t* src, uint8_t* dst, int pixels, int channels, float saturation) {
+    if (channels < 3) { // 非 RGB 影像不處理飽和度
+        if (src != dst) std::copy(src, src + static_cast<size_t>(pixels) * channels, dst);
+        return;
+    }
+
+    for (int x = 0; x < pixels; x++) {
+        const uint8_t* p = src + x * channels;
+        uint8_t* q = dst + x * channels;
 
-    for (int y = 0; y < img.getHeight(); y++) {
-        for (int x = 0; x < img.getWidth(); x++) {
-            for (int c = 0; c < img.getChannels(); c++) {
-                int sum = 0, count = 0;
+        float r = p[0] / 255.0f;
+        float g = p[1] / 255.0f;
+        float b = p[2] / 255.0f;
+
+        float gray = 0.299f * r + 0.587f * g + 0.114f * b;
+
+        r = std::clamp(gray + (r - gray) * saturation, 0.0f, 1.0f);
+        g = std::clamp(gray + (g - gray) * saturation, 0.0f, 1.0f);
+        b = std::clamp(gray + (b - gray) * saturation, 0.0f, 1.0f);
+
+        q[0] = static_cast<uint8_t>(r * 255);
+        q[1] = static_cast<uint8_t>(g * 255);
+        q[2] = static_cast<uint8_t>(b * 255);
+        if (channels == 4) { // 保持 alpha 通道
+            q[3] = p[3];
+        }
+    }
+}
+
+void colorTemperatureRow(const uint8_t* src, uint8_t* dst, int pixels, int channels, int temperature) {
+    if (channels < 3) { // 非 RGB 影像不處理色溫
+        if (src != dst) std::copy(src, src + static_cast<size_t>(pixels) * channels, dst);
+        return;
+    }
+
+    for (int x = 0; x < pixels; x++) {
+        const uint8_t* p = src + x * channels;
+        uint8_t* q = dst + x * channels;
+
+        q[0] = static_cast<uint8_t>(std::clamp(p[0] + temperature, 0, 255));
+        q[1] = p[1];
+        q[2] = static_cast<uint8_t>(std::clamp(p[2] - temperature, 0, 255));
+        if (channels == 4) { // 保持 alpha 通道
+            q[3] = p[3];
+        }
+    }
+}
+
+void blurRegion(const PixelRegion& src, const PixelRegion& dst, int radius, int imageWidth, int imageHeight) {
+    const int channels = dst.channels;
+    const int count = (2 * radius + 1) * (2 * radius + 1);
+
+    for (int y = dst.y; y < dst.y + dst.height; y++) {
+        uint8_t* out = dst.row(y);
+        for (int x = dst.x; x < dst.x + dst.width; x++) {
+            for (int c = 0; c < channels; c++) {
+                int sum = 0;
 
                 // 平均周圍像素
                 for (int ky = -radius; ky <= radius; ky++) {
+                    const uint8_t* in = src.row(std::clamp(y + ky, 0, imageHeight - 1));
                     for (int kx = -radius; kx <= radius; kx++) {
-                        int nx = std::clamp(x + kx, 0, img.getWidth() - 1);
-                        int ny = std::clamp(y + ky, 0, img.getHeight() - 1);
-                        sum += srcData[(ny * img.getWidth() + nx) * img.getChannels() + c];
-                        count++;
+                        int nx = std::clamp(x + kx, 0, imageWidth - 1);
+                        sum += in[(nx - src.x) * channels + c];
                     }
                 }
 
-                destData[(y * img.getWidth() + x) * img.getChannels() + c] = sum / count;
+                out[(x - dst.x) * channels + c] = sum / count;
             }
         }
     }
+}
+
+// 逐列平行套用點運算核心 kernel(srcRow, destRow)
+template <typename RowKernel>
+static Image applyRowKernel(const Image& img, int destChannels, const ExecutionContext& ctx, RowKernel kernel) {
+    Image result(img.getWidth(), img.getHeight(), destChannels);
+    const PixelRegion src = imageRegion(img);
+    const PixelRegion dst = imageRegion(result);
+
+    // 以列為單位分塊，每列輸出互不相依，結果與執行緒數無關
+    parallelFor(ctx, 0, img.getHeight(), [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            kernel(src.row(y), dst.row(y));
+        }
+    });
     return result;
 }
 
-// 顏色反轉
-Image applyInvertColors(const Image& img) {
-    Image result(img.getWidth(), img.getHeight(), img.getChannels());
-    const auto& srcData = img.getData();
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
+// 灰階轉換
+Image applyGrayscale(const Image& img, GrayscaleMode mode, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyGrayscale");
+    if (img.getChannels() < 3) return img; // 不處理少於 3 通道的影像
 
-    for (size_t i = 0; i < srcData.size(); i++) {
-        destData[i] = 255 - srcData[i];
-    }
-    return result;
+    const int width = img.getWidth();
+    const int channels = img.getChannels();
+    const bool singleChannel = (mode == GrayscaleMode::SingleChannel);
+
+    return applyRowKernel(img, singleChannel ? 1 : channels, ctx, [&](const uint8_t* src, uint8_t* dst) {
+        grayscaleRow(src, dst, width, channels, singleChannel);
+    });
 }
 
-// 亮度調整
-Image applyBrightness(const Image& img, int brightness) {
-    Image result(img.getWidth(), img.getHeight(), img.getChannels());
-    const auto& srcData = img.getData();
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
+// 模糊處理
+Image applyBlur(const Image& img, int radius, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyBlur");
+    if (radius <= 0) return img;
 
-    #pragma omp parallel for
-    for (int i = 0; i < static_cast<int>(srcData.size()); i++) {
-        int adjusted = static_cast<int>(srcData[i]) + brightness;
-        destData[i] = (adjusted < 0) ? 0 : (adjusted > 255 ? 255 : adjusted); // 手動 clamp
-    }
+    Image result(img.getWidth(), img.getHeight(), img.getChannels());
+    const PixelRegion src = imageRegion(img);
+    const PixelRegion dst = imageRegion(result);
+
+    // 以列為單位分塊，每個輸出像素只讀取來源影像，結果與執行緒數無關
+    parallelFor(ctx, 0, img.getHeight(), [&](int y0, int y1) {
+        PixelRegion rows = dst;
+        rows.data = dst.row(y0);
+        rows.y = y0;
+        rows.height = y1 - y0;
+        blurRegion(src, rows, radius, img.getWidth(), img.getHeight());
+    });
     return result;
 }
 
-Image applyContrast(const Image& img, float contrast) {
-    Image result(img.getWidth(), img.getHeight(), img.getChannels());
-    const auto& srcData = img.getData();
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
+// 逐像素半徑的模糊
+Image applyVariableBlur(const Image& img, const Image& radiusMap, int maxRadius, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyVariableBlur");
+    if (radiusMap.getWidth() != img.getWidth() || radiusMap.getHeight() != img.getHeight()) {
+        throw std::runtime_error("Radius map size does not match image size");
+    }
+    maxRadius = std::min(maxRadius, kMaxVariableBlurRadius);
+    if (maxRadius <= 0) return img;
 
-    #pragma omp parallel for
-    for (int i = 0; i < static_cast<int>(srcData.size()); i++) {
-        int adjusted = static_cast<int>(128 + (srcData[i] - 128) * contrast);
-        destData[i] = (adjusted < 0) ? 0 : (adjusted > 255 ? 255 : adjusted); // 手動 clamp
+    // 灰階值對應的半徑
+    int radii[256];
+    for (int v = 0; v < 256; v++) {
+        radii[v] = (v * maxRadius + 127) / 255;
     }
+
+    const IntegralImage integral(img, ctx);
+    const int width = img.getWidth();
+    const int channels = img.getChannels();
+    const int mapChannels = radiusMap.getChannels();
+    Image result(width, img.getHeight(), channels);
+    const PixelRegion src = imageRegion(img);
+    const PixelRegion dst = imageRegion(result);
+    const PixelRegion map = imageRegion(radiusMap);
+
+    parallelFor(ctx, 0, img.getHeight(), [&](int y0, int y1) {
+        std::vector<uint32_t> sums(channels);
+        for (int y = y0; y < y1; y++) {
+            const uint8_t* in = src.row(y);
+            const uint8_t* m = map.row(y);
+            uint8_t* out = dst.row(y);
+            for (int x = 0; x < width; x++, m += mapChannels) {
+                const int radius = radii[mapChannels >= 3 ? grayFromRGB(m[0], m[1], m[2]) : m[0]];
+                if (radius == 0) {
+                    std::copy(in + x * channels, in + (x + 1) * channels, out + x * channels);
+                    continue;
+                }
+                integral.clampedSum(x - radius, y - radius, x + radius + 1, y + radius + 1, sums.data());
+                const uint32_t count = static_cast<uint32_t>(2 * radius + 1) * (2 * radius + 1);
+                for (int c = 0; c < channels; c++) {
+                    out[x * channels + c] = static_cast<uint8_t>(sums[c] / count);
+                }
+            }
+        }
+    });
     return result;
 }
 
-Image applySaturation(const Image& img, float saturation) {
-    Image result(img.getWidth(), img.getHeight(), img.getChannels());
-    const auto& srcData = img.getData();
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
+// 中值濾波的直方圖：每個通道 256 個細分格接著 16 個粗分格 (每個粗分格是連續 16 個細分格的和)，計數為 16 位元
+// 加減都以 16 格 (一個粗分格或一段細分格) 為單位，SSE2 每次處理 8 格
+static const int kMedianBins = 256;
+static const int kMedianHistogramSize = kMedianBins + 16;
+
+// dst[0..16) += add
+static inline void histogramAdd16(uint16_t* dst, const uint16_t* add) {
+#ifdef IMAGE_PROCESSING_X86
+    for (int i = 0; i < 16; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi16(d, a));
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        dst[i] = static_cast<uint16_t>(dst[i] + add[i]);
+    }
+#endif
+}
 
-    if (img.getChannels() < 3) {
-        return img; // 若圖片不是 RGB，則不處理飽和度
+// dst[0..16) += add - sub
+static inline void histogramAddSub16(uint16_t* dst, const uint16_t* add, const uint16_t* sub) {
+#ifdef IMAGE_PROCESSING_X86
+    for (int i = 0; i < 16; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i));
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_sub_epi16(_mm_add_epi16(d, a), s));
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        dst[i] = static_cast<uint16_t>(dst[i] + add[i] - sub[i]);
     }
+#endif
+}
 
-    #pragma omp parallel for
-    for (int i = 0; i < static_cast<int>(srcData.size()); i += img.getChannels()) {
-        float r = srcData[i] / 255.0f;
-        float g = srcData[i + 1] / 255.0f;
-        float b = srcData[i + 2] / 255.0f;
+// 一個通道的視窗直方圖：粗分格每個像素都更新，細分格只在中位數落入該段時才補上落後的欄
+struct MedianKernel {
+    uint16_t coarse[16];
+    uint16_t fine[kMedianBins];
+    int updatedAt[16]; // 細分格各段目前對應的視窗中心 x
+};
+
+// 中值濾波
+Image applyMedian(const Image& img, int radius, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyMedian");
+    radius = std::min(radius, kMaxMedianRadius);
+    if (radius <= 0) return img;
 
-        float gray = 0.299f * r + 0.587f * g + 0.114f * b;
+    const int width = img.getWidth();
+    const int height = img.getHeight();
+    const int channels = img.getChannels();
+    const int diameter = 2 * radius + 1;
+    const int pixelHistogramSize = channels * kMedianHistogramSize;
+    const int rank = diameter * diameter / 2;
+    const int stale = std::numeric_limits<int>::min() / 2;
+    Image result(width, height, channels);
+    const PixelRegion src = imageRegion(img);
+    const PixelRegion dst = imageRegion(result);
+
+    // 垂直條帶各自由上往下處理，條帶寬度與執行緒數無關
+    // 條帶越寬，每列重建視窗粗分格的成本分攤越少，但欄直方圖 (每欄每通道 544 位元組) 要留在快取內
+    const int stripWidth = std::max(128, 2 * diameter);
+    const int strips = (width + stripWidth - 1) / stripWidth;
+
+    parallelFor(ctx, 0, strips, [&](int s0, int s1) {
+        for (int strip = s0; strip < s1; strip++) {
+            const int x0 = strip * stripWidth;
+            const int x1 = std::min(width, x0 + stripWidth);
+            // 條帶與左右各 radius 欄的欄直方圖 (範圍外的欄重複使用邊緣欄)
+            const int cx0 = std::max(0, x0 - radius);
+            const int cx1 = std::min(width, x1 + radius);
+            std::vector<uint16_t> columns(static_cast<size_t>(cx1 - cx0) * pixelHistogramSize, 0);
+            std::vector<MedianKernel> kernels(channels);
+            auto column = [&](int x, int channel) {
+                return columns.data() + static_cast<size_t>(std::clamp(x, 0, width - 1) - cx0) * pixelHistogramSize +
+                    channel * kMedianHistogramSize;
+            };
+            auto update = [&](int y, int delta) {
+                const uint8_t* in = src.row(std::clamp(y, 0, height - 1)) + cx0 * channels;
+                uint16_t* hist = columns.data();
+                for (int x = cx0; x < cx1; x++) {
+                    for (int c = 0; c < channels; c++, hist += kMedianHistogramSize) {
+                        const uint8_t v = *in++;
+                        hist[v] = static_cast<uint16_t>(hist[v] + delta);
+                        hist[kMedianBins + (v >> 4)] = static_cast<uint16_t>(hist[kMedianBins + (v >> 4)] + delta);
+                    }
+                }
+            };
 
-        r = std::clamp(gray + (r - gray) * saturation, 0.0f, 1.0f);
-        g = std::clamp(gray + (g - gray) * saturation, 0.0f, 1.0f);
-        b = std::clamp(gray + (b - gray) * saturation, 0.0f, 1.0f);
+            for (int y = -radius; y <= radius; y++) {
+                update(y, 1);
+            }
+            for (int y = 0; y < height; y++) {
+                // 欄直方圖往下移一列 (上下邊界外的列重複邊緣列，移出與移入同一列時不變)
+                if (y > 0 && std::clamp(y - radius - 1, 0, height - 1) != std::clamp(y + radius, 0, height - 1)) {
+                    update(y - radius - 1, -1);
+                    update(y + radius, 1);
+                }
 
-        destData[i] = static_cast<uint8_t>(r * 255);
-        destData[i + 1] = static_cast<uint8_t>(g * 255);
-        destData[i + 2] = static_cast<uint8_t>(b * 255);
-    }
+                for (int c = 0; c < channels; c++) {
+                    MedianKernel& kernel = kernels[c];
+                    std::fill(std::begin(kernel.coarse), std::end(kernel.coarse), 0);
+                    std::fill(std::begin(kernel.updatedAt), std::end(kernel.updatedAt), stale);
+                    for (int x = x0 - radius; x <= x0 + radius; x++) {
+                        histogramAdd16(kernel.coarse, column(x, c) + kMedianBins);
+                    }
+                }
+
+                uint8_t* out = dst.row(y) + x0 * channels;
+                for (int x = x0; x < x1; x++) {
+                    for (int c = 0; c < channels; c++) {
+                        MedianKernel& kernel = kernels[c];
+                        if (x > x0) {
+                            histogramAddSub16(kernel.coarse, column(x + radius, c) + kMedianBins, column(x - radius - 1, c) + kMedianBins);
+                        }
+
+                        int rest = rank;
+                        int bin = 0;
+                        while (rest >= kernel.coarse[bin]) {
+                            rest -= kernel.coarse[bin];
+                            bin++;
+                        }
+
+                        // 把這一段細分格移到目前的視窗；落後超過視窗寬度時直接重新加總
+                        uint16_t* fine = kernel.fine + bin * 16;
+                        const int offset = bin * 16;
+                        if (x - kernel.updatedAt[bin] > diameter) {
+                            std::fill(fine, fine + 16, 0);
+                            for (int cx = x - radius; cx <= x + radius; cx++) {
+                                histogramAdd16(fine, column(cx, c) + offset);
+                            }
+                        }
+                        else {
+                            for (int cx = kernel.updatedAt[bin] + 1; cx <= x; cx++) {
+                                histogramAddSub16(fine, column(cx + radius, c) + offset, column(cx - radius - 1, c) + offset);
+                            }
+                        }
+                        kernel.updatedAt[bin] = x;
+
+                        int value = 0;
+                        while (rest >= fine[value]) {
+                            rest -= fine[value];
+                            value++;
+                        }
+                        *out++ = static_cast<uint8_t>(offset + value);
+                    }
+                }
+            }
+        }
+    });
     return result;
 }
 
-Image applyColorTemperature(const Image& img, int temperature) {
-    Image result(img.getWidth(), img.getHeight(), img.getChannels());
-    const auto& srcData = img.getData();
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
+// 顏色反轉
+Image applyInvertColors(const Image& img, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyInvertColors");
+    const size_t rowBytes = static_cast<size_t>(img.getWidth()) * img.getChannels();
+    return applyRowKernel(img, img.getChannels(), ctx, [&](const uint8_t* src, uint8_t* dst) {
+        invertRow(src, dst, rowBytes);
+    });
+}
+
+// 亮度調整
+Image applyBrightness(const Image& img, int brightness, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyBrightness");
+    const size_t rowBytes = static_cast<size_t>(img.getWidth()) * img.getChannels();
+    return applyRowKernel(img, img.getChannels(), ctx, [&](const uint8_t* src, uint8_t* dst) {
+        brightnessRow(src, dst, rowBytes, brightness);
+    });
+}
+
+Image applyContrast(const Image& img, float contrast, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyContrast");
+    const size_t rowBytes = static_cast<size_t>(img.getWidth()) * img.getChannels();
+    return applyRowKernel(img, img.getChannels(), ctx, [&](const uint8_t* src, uint8_t* dst) {
+        contrastRow(src, dst, rowBytes, contrast);
+    });
+}
 
+Image applySaturation(const Image& img, float saturation, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applySaturation");
     if (img.getChannels() < 3) {
-        return img; // 若圖片不是 RGB，則不處理色溫
+        return img; // 若圖片不是 RGB，則不處理飽和度
     }
 
-    #pragma omp parallel for
-    for (int i = 0; i < static_cast<int>(srcData.size()); i += img.getChannels()) {
-        int r = srcData[i];
-        int g = srcData[i + 1];
-        int b = srcData[i + 2];
-
-        r = std::clamp(r + temperature, 0, 255);
-        b = std::clamp(b - temperature, 0, 255);
+    return applyRowKernel(img, img.getChannels(), ctx, [&](const uint8_t* src, uint8_t* dst) {
+        saturationRow(src, dst, img.getWidth(), img.getChannels(), saturation);
+    });
+}
 
-        destData[i] = static_cast<uint8_t>(r);
-        destData[i + 1] = static_cast<uint8_t>(g);
-        destData[i + 2] = static_cast<uint8_t>(b);
+Image applyColorTemperature(const Image& img, int temperature, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyColorTemperature");
+    if (img.getChannels() < 3) {
+        return img; // 若圖片不是 RGB，則不處理色溫
     }
-    return result;
+
+    return applyRowKernel(img, img.getChannels(), ctx, [&](const uint8_t* src, uint8_t* dst) {
+        colorTemperatureRow(src, dst, img.getWidth(), img.getChannels(), temperature);
+    });
+}
+
+Image applyProjection(const Image& panorama, double /*R*/, float /*scaleFactor*/, const ExecutionContext& ctx) {
+    // 加載遮罩圖像
+    Image mask = [] {
+        memstats::StageScope stage("projection mask");
+        return Image::loadFromJPG("paranoma_mask.JPG");
+    }();
+    return applyProjection(panorama, mask, ctx);
 }
 
-Image applyProjection(const Image& panorama, double R, float scaleFactor) {
+Image applyProjection(const Image& panorama, const Image& mask, const ExecutionContext& ctx) {
+    TRACE_SCOPE("applyProjection");
     const int width = panorama.getWidth();
     const int height = panorama.getHeight();
     const int channels = panorama.getChannels();
@@ -174,9 +578,7 @@ Image applyProjection(const Image& panorama, double R, float scaleFactor) {
     const float cx = width / 2.0f;
     const float cy = height / 2.0f;
 
-    // 加載遮罩圖像
-    Image mask = Image::loadFromJPG("paranoma_mask.JPG");
-    const auto& maskData = mask.getData();
+    const uint8_t* maskData = mask.pixels();
     if (mask.getWidth() != width || mask.getHeight() != height) {
         throw std::runtime_error("Mask size does not match panorama size");
     }
@@ -191,6 +593,7 @@ Image applyProjection(const Image& panorama, double R, float scaleFactor) {
 
     // 定義每個網格的重要性
     std::vector<std::vector<float>> gridImportance(gridRows + 1, std::vector<float>(gridCols + 1, 1.0f));
+    const memstats::Allocation gridAllocation((gridRows + 1) * (gridCols + 1) * (sizeof(std::pair<float, float>) + sizeof(float)), "remap grid");
     for (int row = 0; row <= gridRows; row++) {
         for (int col = 0; col <= gridCols; col++) {
             int maskX = static_cast<int>((col * gridWidth) * (static_cast<float>(width) / newWidth));
@@ -200,10 +603,13 @@ Image applyProjection(const Image& panorama, double R, float scaleFactor) {
             if (maskX >= 0 && maskY >= 0 && maskX < width && maskY < height) {
                 int maskIndex = (maskY * width + maskX) * mask.getChannels();
 
-                // 將 RGB 遮罩轉為灰度值
-                float grayValue = 0.2989f * maskData[maskIndex] +    // R 通道
-                    0.5870f * maskData[maskIndex + 1] + // G 通道
-                    0.1140f * maskData[maskIndex + 2];  // B 通道
+                // 單通道遮罩直接使用亮度，RGB 遮罩轉為灰度值
+                float grayValue = maskData[maskIndex];
+                if (mask.getChannels() >= 3) {
+                    grayValue = 0.2989f * maskData[maskIndex] +    // R 通道
+                        0.5870f * maskData[maskIndex + 1] + // G 通道
+                        0.1140f * maskData[maskIndex + 2];  // B 通道
+                }
 
                 // 如果灰度值超過閾值，則設置為高重要性
                 if (grayValue > 128) {
@@ -255,54 +661,92 @@ Image applyProjection(const Image& panorama, double R, float scaleFactor) {
 
     // 應用變形並生成輸出圖像
     Image result(newWidth, newHeight, channels);
-    auto& destData = const_cast<std::vector<uint8_t>&>(result.getData());
-    const auto& srcData = panorama.getData();
-
-    #pragma omp parallel for
-    for (int row = 0; row < gridRows; row++) {
-        for (int col = 0; col < gridCols; col++) {
-            auto topLeft = grid[row][col];
-            auto topRight = grid[row][col + 1];
-            auto bottomLeft = grid[row + 1][col];
-            auto bottomRight = grid[row + 1][col + 1];
-
-            for (int y = row * gridHeight; y < (row + 1) * gridHeight; y++) {
-                for (int x = col * gridWidth; x < (col + 1) * gridWidth; x++) {
-                    float alphaX = (x - col * gridWidth) / (float)gridWidth;
-                    float alphaY = (y - row * gridHeight) / (float)gridHeight;
-
-                    float warpedX = topLeft.first * (1 - alphaX) * (1 - alphaY) +
-                        topRight.first * alphaX * (1 - alphaY) +
-                        bottomLeft.first * (1 - alphaX) * alphaY +
-                        bottomRight.first * alphaX * alphaY;
-
-                    float warpedY = topLeft.second * (1 - alphaX) * (1 - alphaY) +
-                        topRight.second * alphaX * (1 - alphaY) +
-                        bottomLeft.second * (1 - alphaX) * alphaY +
-                        bottomRight.second * alphaX * alphaY;
-
-                    warpedX = std::clamp(warpedX, 0.0f, (float)(width - 1));
-                    warpedY = std::clamp(warpedY, 0.0f, (float)(height - 1));
-
-                    int srcX = static_cast<int>(warpedX);
-                    int srcY = static_cast<int>(warpedY);
-
-                    for (int c = 0; c < channels; c++) {
-                        destData[(y * newWidth + x) * channels + c] =
-                            srcData[(srcY * width + srcX) * channels + c];
+    uint8_t* destData = result.mutablePixels();
+    const uint8_t* srcData = panorama.pixels();
+
+    parallelFor(ctx, 0, gridRows, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; row++) {
+            for (int col = 0; col < gridCols; col++) {
+                auto topLeft = grid[row][col];
+                auto topRight = grid[row][col + 1];
+                auto bottomLeft = grid[row + 1][col];
+                auto bottomRight = grid[row + 1][col + 1];
+
+                for (int y = row * gridHeight; y < (row + 1) * gridHeight; y++) {
+                    for (int x = col * gridWidth; x < (col + 1) * gridWidth; x++) {
+                        float alphaX = (x - col * gridWidth) / (float)gridWidth;
+                        float alphaY = (y - row * gridHeight) / (float)gridHeight;
+
+                        float warpedX = topLeft.first * (1 - alphaX) * (1 - alphaY) +
+                            topRight.first * alphaX * (1 - alphaY) +
+                            bottomLeft.first * (1 - alphaX) * alphaY +
+                            bottomRight.first * alphaX * alphaY;
+
+                        float warpedY = topLeft.second * (1 - alphaX) * (1 - alphaY) +
+                            topRight.second * alphaX * (1 - alphaY) +
+                            bottomLeft.second * (1 - alphaX) * alphaY +
+                            bottomRight.second * alphaX * alphaY;
+
+                        warpedX = std::clamp(warpedX, 0.0f, (float)(width - 1));
+                        warpedY = std::clamp(warpedY, 0.0f, (float)(height - 1));
+
+                        int srcX = static_cast<int>(warpedX);
+                        int srcY = static_cast<int>(warpedY);
+
+                        for (int c = 0; c < channels; c++) {
+                            destData[(y * newWidth + x) * channels + c] =
+                                srcData[(srcY * width + srcX) * channels + c];
+                        }
                     }
                 }
             }
         }
-    }
+    });
 
     return result;
 }
 
-Image processImage(const Image& img, int brightness, float contrast, float saturation, int temperature) {
-    Image result = applyBrightness(img, brightness);
-    result = applyContrast(result, contrast);
-    result = applySaturation(result, saturation);
-    result = applyColorTemperature(result, temperature);
+Image processImage(const Image& img, int brightness, float contrast, float saturation, int temperature, const ExecutionContext& ctx) {
+    TRACE_SCOPE("processImage");
+    // 四個調整合併成一次查表與一次飽和度運算
+    Pipeline adjustments = pipeline(img)
+        | ops::brightness(brightness)
+        | ops::contrast(contrast)
+        | ops::saturation(saturation)
+        | ops::colorTemperature(temperature);
+    return adjustments.evaluate(ctx);
+}
+
+// 亮度與對比作用在 Y；對比與飽和度都等於把 Cb / Cr 相對 128 的偏移乘上倍率；
+// 色溫 (R + t、B - t) 換算成 Y、Cb、Cr 的固定偏移 (BT.601 係數)
+YCbCrImage processImage(const YCbCrImage& img, int brightness, float contrast, float saturation, int temperature, const ExecutionContext& ctx) {
+    TRACE_SCOPE("processImage (YCbCr)");
+    auto toByte = [](float v) { return static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(v)), 0, 255)); };
+
+    uint8_t luts[3][256];
+    for (int v = 0; v < 256; v++) luts[0][v] = static_cast<uint8_t>(v);
+    brightnessRow(luts[0], luts[0], 256, brightness);
+    contrastRow(luts[0], luts[0], 256, contrast);
+
+    // 灰階影像與 RGB 路徑一致，不處理色溫
+    const float lumaShift = img.isGrayscale() ? 0.0f : 0.185f * temperature;
+    const float chromaScale = contrast * saturation;
+    for (int v = 0; v < 256; v++) {
+        luts[0][v] = toByte(luts[0][v] + lumaShift);
+        luts[1][v] = toByte(128 + (v - 128) * chromaScale - 0.668736f * temperature);
+        luts[2][v] = toByte(128 + (v - 128) * chromaScale + 0.581312f * temperature);
+    }
+
+    YCbCrImage result = img;
+    for (int i = 0; i < result.planeCount(); i++) {
+        const uint8_t* lut = luts[i];
+        const size_t width = result.planeWidth(i);
+        uint8_t* data = result.plane(i).data();
+        parallelFor(ctx, 0, result.planeHeight(i), [&](int y0, int y1) {
+            for (size_t p = y0 * width; p < y1 * width; p++) {
+                data[p] = lut[data[p]];
+            }
+        });
+    }
     return result;
-}
\ No newline at end of file
+}
@@ -10,24 +10,49 @@
 #endif
 
 #include "Image.h"
+#include "YCbCrImage.h"
+#include "ThreadPool.h"
 
-// 灰階轉換
-Image applyGrayscale(const Image& img);
+// 灰階輸出模式
+enum class GrayscaleMode {
+    Replicated,    // 灰階值複製到 RGB 三個通道 (保留 alpha)
+    SingleChannel  // 輸出單通道影像
+};
+
+// 灰階轉換 (定點數權重)
+Image applyGrayscale(const Image& img, GrayscaleMode mode = GrayscaleMode::Replicated,
+                     const ExecutionContext& ctx = ExecutionContext::defaultContext());
 
 // 應用模糊
-Image applyBlur(const Image& img, int radius);
+Image applyBlur(const Image& img, int radius, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+// 逐像素半徑的方框模糊 (景深、移軸效果)：radiusMap 與 img 同尺寸，單通道或 RGB (取灰階)，
+// 灰階值 v 對應半徑 round(v * maxRadius / 255)，可以直接用 applyProjection 的遮罩
+// 以積分影像計算，每個像素的成本與半徑無關；邊界處理與 applyBlur 相同，半徑處處相同時結果也相同
+const int kMaxVariableBlurRadius = 2047; // 視窗面積須小於 IntegralImage::kMaxExactArea，超過時限制在此值
+Image applyVariableBlur(const Image& img, const Image& radiusMap, int maxRadius, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+// 中值濾波 (去除椒鹽雜訊、清理遮罩)：(2 * radius + 1)^2 視窗內每個通道各自取中位數，邊界處理與 applyBlur 相同
+// Perreault-Hébert 直方圖法，每個像素的成本與半徑無關
+const int kMaxMedianRadius = 127; // 直方圖計數為 16 位元，視窗面積須小於 65536，超過時限制在此值
+Image applyMedian(const Image& img, int radius, const ExecutionContext& ctx = ExecutionContext::defaultContext());
 
 // 顏色反轉
-Image applyInvertColors(const Image& img);
+Image applyInvertColors(const Image& img, const ExecutionContext& ctx = ExecutionContext::defaultContext());
 
 // 調整亮度
-Image applyBrightness(const Image& img, int brightness);
-Image applyContrast(const Image& img, float contrast);
-Image applyColorTemperature(const Image& img, int temperature);
-Image applySaturation(const Image& img, float saturation);
-Image applyProjection(const Image& panorama, double R, float scaleFactor);
-
-Image processImage(const Image& img, int brightness, float contrast, float saturation, int temperature);
+Image applyBrightness(const Image& img, int brightness, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+Image applyContrast(const Image& img, float contrast, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+Image applyColorTemperature(const Image& img, int temperature, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+Image applySaturation(const Image& img, float saturation, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+// R 與 scaleFactor 目前的實作不使用 (保留原本的介面)
+Image applyProjection(const Image& panorama, double R, float scaleFactor, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+// 使用指定的遮罩 (與全景圖同尺寸，單通道或 RGB)，不從 paranoma_mask.JPG 載入
+Image applyProjection(const Image& panorama, const Image& mask, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+Image processImage(const Image& img, int brightness, float contrast, float saturation, int temperature, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+// 直接在 Y / Cb / Cr 平面上調整 (不轉回 RGB)，忽略 RGB 各通道的截斷，結果與 RGB 版本近似
+YCbCrImage processImage(const YCbCrImage& img, int brightness, float contrast, float saturation, int temperature, const ExecutionContext& ctx = ExecutionContext::defaultContext());
 
 
 #endif // IMAGE_PROCESSING_H
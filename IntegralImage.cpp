@@ -0,0 +1,74 @@
+#include "IntegralImage.h"
+#include "Trace.h"
+#include <algorithm>
+
+IntegralImage::IntegralImage(const Image& img, const ExecutionContext& ctx)
+    : width(img.getWidth()), height(img.getHeight()), channels(img.getChannels()),
+      table(static_cast<size_t>(width + 1) * (height + 1) * channels, 0),
+      allocation(table.size() * sizeof(uint32_t), "integral image") {
+    TRACE_SCOPE("IntegralImage");
+    const size_t rowEntries = static_cast<size_t>(width + 1) * channels;
+    const size_t srcStride = static_cast<size_t>(width) * channels;
+    const uint8_t* src = img.pixels();
+    uint32_t* base = table.data();
+
+    // 第一趟：每列各自的前綴和 (列與列互不相依)
+    parallelFor(ctx, 0, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const uint8_t* in = src + y * srcStride;
+            uint32_t* row = base + (y + 1) * rowEntries;
+            for (size_t i = 0; i < srcStride; i++) {
+                row[i + channels] = row[i] + in[i];
+            }
+        }
+    });
+
+    // 第二趟：欄切成區塊，每個區塊由上往下把上一列加到這一列 (區塊內的每一段都是連續記憶體，可向量化)
+    const int blockEntries = 256;
+    const int blocks = static_cast<int>((rowEntries + blockEntries - 1) / blockEntries);
+    parallelFor(ctx, 0, blocks, [&](int b0, int b1) {
+        const size_t begin = static_cast<size_t>(b0) * blockEntries;
+        const size_t end = std::min(rowEntries, static_cast<size_t>(b1) * blockEntries);
+        for (int y = 2; y <= height; y++) {
+            uint32_t* row = base + y * rowEntries;
+            const uint32_t* above = row - rowEntries;
+            for (size_t i = begin; i < end; i++) {
+                row[i] += above[i];
+            }
+        }
+    });
+}
+
+void IntegralImage::addSum(int x0, int y0, int x1, int y1, uint32_t weight, uint32_t* out) const {
+    const uint32_t* a = at(x0, y0);
+    const uint32_t* b = at(x1, y0);
+    const uint32_t* c = at(x0, y1);
+    const uint32_t* d = at(x1, y1);
+    for (int ch = 0; ch < channels; ch++) {
+        out[ch] += weight * (d[ch] - c[ch] - b[ch] + a[ch]);
+    }
+}
+
+void IntegralImage::clampedSum(int x0, int y0, int x1, int y1, uint32_t* out) const {
+    std::fill(out, out + channels, 0u);
+    const int cx0 = std::max(x0, 0);
+    const int cy0 = std::max(y0, 0);
+    const int cx1 = std::min(x1, width);
+    const int cy1 = std::min(y1, height);
+    addSum(cx0, cy0, cx1, cy1, 1, out);
+    if (cx0 == x0 && cy0 == y0 && cx1 == x1 && cy1 == y1) return;
+
+    // 範圍外的欄 / 列重複邊緣：四條邊各乘上超出的欄數或列數，四個角乘上兩者的積
+    const uint32_t left = cx0 - x0;
+    const uint32_t right = x1 - cx1;
+    const uint32_t top = cy0 - y0;
+    const uint32_t bottom = y1 - cy1;
+    if (left) addSum(0, cy0, 1, cy1, left, out);
+    if (right) addSum(width - 1, cy0, width, cy1, right, out);
+    if (top) addSum(cx0, 0, cx1, 1, top, out);
+    if (bottom) addSum(cx0, height - 1, cx1, height, bottom, out);
+    if (left && top) addSum(0, 0, 1, 1, left * top, out);
+    if (right && top) addSum(width - 1, 0, width, 1, right * top, out);
+    if (left && bottom) addSum(0, height - 1, 1, height, left * bottom, out);
+    if (right && bottom) addSum(width - 1, height - 1, width, height, right * bottom, out);
+}
@@ -0,0 +1,47 @@
+#ifndef INTEGRAL_IMAGE_H
+#define INTEGRAL_IMAGE_H
+
+#include "Image.h"
+#include "MemoryStats.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+// 積分影像 (summed-area table)：位置 (x, y) 存放 [0, x) x [0, y) 內各通道的總和，任意矩形的總和只要查四個值
+// 以 32 位元無號整數儲存，溢位時取 2^32 的餘數；矩形總和以模運算相減仍然正確，
+// 前提是矩形內真正的總和小於 2^32，也就是面積不超過 kMaxExactArea 個像素 (與影像大小無關)
+// 建表分兩趟平行：逐列計算前綴和，再依欄區塊由上往下累加
+class IntegralImage {
+public:
+    static constexpr uint32_t kMaxExactArea = 0xFFFFFFFFu / 255;
+
+    explicit IntegralImage(const Image& img, const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getChannels() const { return channels; }
+
+    // [x0, x1) x [y0, y1) 內 channel 的總和，矩形必須在影像範圍內
+    uint32_t sum(int x0, int y0, int x1, int y1, int channel) const {
+        return at(x1, y1)[channel] - at(x0, y1)[channel] - at(x1, y0)[channel] + at(x0, y0)[channel];
+    }
+
+    // [x0, x1) x [y0, y1) 內每個通道的總和寫到 out[0 .. channels)
+    // 範圍外的座標取最近的邊緣像素 (與 applyBlur 的邊界處理相同)，矩形必須與影像相交
+    void clampedSum(int x0, int y0, int x1, int y1, uint32_t* out) const;
+
+private:
+    const uint32_t* at(int x, int y) const {
+        return table.data() + (static_cast<size_t>(y) * (width + 1) + x) * channels;
+    }
+    // out += weight * [x0, x1) x [y0, y1) 的總和
+    void addSum(int x0, int y0, int x1, int y1, uint32_t weight, uint32_t* out) const;
+
+    int width;
+    int height;
+    int channels;
+    std::vector<uint32_t> table; // (width + 1) x (height + 1) 個位置，各通道交錯存放，第 0 列與第 0 欄為 0
+    memstats::Allocation allocation;
+};
+
+#endif // INTEGRAL_IMAGE_H
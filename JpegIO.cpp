@@ -0,0 +1,183 @@
+#include "JpegIO.h"
+#include "Image.h"
+#include "Trace.h"
+#include "stb_image_write.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+    // 少於這個 MCU 列數時直接單執行緒編碼
+    const int MIN_PARALLEL_MCU_ROWS = 8;
+
+    // EXIF 段最多讀這麼多位元組，方向標籤位於緊接 TIFF 檔頭的 IFD0
+    const int MAX_EXIF_BYTES = 4096;
+
+    struct FileCloser {
+        void operator()(FILE* f) const { fclose(f); }
+    };
+
+    // SOF0-SOF15，排除 DHT (C4)、JPG (C8) 與 DAC (CC)
+    bool isStartOfFrame(int marker) {
+        return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+    }
+
+    // 從 APP1 段內容解析 EXIF 方向 (標籤 0x0112)，沒有或無效時為 1
+    int exifOrientation(const uint8_t* p, size_t n) {
+        if (n < 14 || std::memcmp(p, "Exif\0\0", 6) != 0) return 1;
+        const uint8_t* tiff = p + 6;
+        n -= 6;
+        const bool little = tiff[0] == 'I' && tiff[1] == 'I';
+        if (!little && !(tiff[0] == 'M' && tiff[1] == 'M')) return 1;
+        auto u16 = [&](size_t o) { return little ? tiff[o] | tiff[o + 1] << 8 : tiff[o] << 8 | tiff[o + 1]; };
+        auto u32 = [&](size_t o) { return static_cast<uint32_t>(little ? u16(o) | u16(o + 2) << 16 : u16(o) << 16 | u16(o + 2)); };
+        if (u16(2) != 42) return 1;
+
+        const size_t ifd = u32(4);
+        if (ifd + 2 > n) return 1;
+        const int count = u16(ifd);
+        for (int i = 0; i < count; i++) {
+            const size_t entry = ifd + 2 + 12 * static_cast<size_t>(i);
+            if (entry + 12 > n) break;
+            if (u16(entry) == 0x0112 && u16(entry + 2) == 3) { // SHORT
+                const int value = u16(entry + 8);
+                return value >= 1 && value <= 8 ? value : 1;
+            }
+        }
+        return 1;
+    }
+}
+
+namespace jpegio {
+    bool readFile(const std::string& filename, std::vector<uint8_t>& bytes) {
+        TRACE_SCOPE("jpegio::readFile");
+        std::unique_ptr<FILE, FileCloser> file(fopen(filename.c_str(), "rb"));
+        if (!file || fseek(file.get(), 0, SEEK_END) != 0) return false;
+        const long size = ftell(file.get());
+        if (size < 0 || size > INT_MAX || fseek(file.get(), 0, SEEK_SET) != 0) return false;
+        bytes.resize(static_cast<size_t>(size));
+        return fread(bytes.data(), 1, bytes.size(), file.get()) == bytes.size();
+    }
+
+    bool scanHeader(FILE* file, ImageInfo& info) {
+        info.orientation = 1;
+        for (;;) {
+            if (fgetc(file) != 0xFF) return false;
+            int marker;
+            do {
+                marker = fgetc(file); // 標記前可以有任意個 0xFF 填充
+            } while (marker == 0xFF);
+            if (marker == EOF || marker == 0xD9 || marker == 0xDA) return false; // SOF 之前不應出現
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) continue;  // 沒有長度欄位
+
+            const int hi = fgetc(file);
+            const int lo = fgetc(file);
+            if (hi == EOF || lo == EOF) return false;
+            const int length = (hi << 8 | lo) - 2;
+            if (length < 0) return false;
+
+            if (isStartOfFrame(marker)) {
+                uint8_t sof[6]; // 精度、高 (2)、寬 (2)、分量數
+                if (length < 6 || fread(sof, 1, sizeof(sof), file) != sizeof(sof)) return false;
+                info.height = sof[1] << 8 | sof[2];
+                info.width = sof[3] << 8 | sof[4];
+                const int components = sof[5];
+                // 高度為 0 (DNL) 與 stb_image 一樣不支援；CMYK 解碼後為 RGB
+                if (info.width == 0 || info.height == 0 || (components != 1 && components != 3 && components != 4)) return false;
+                info.channels = components >= 3 ? 3 : 1;
+                return true;
+            }
+
+            int skip = length;
+            if (marker == 0xE1) {
+                uint8_t segment[MAX_EXIF_BYTES];
+                const int count = std::min(length, MAX_EXIF_BYTES);
+                if (fread(segment, 1, count, file) != static_cast<size_t>(count)) return false;
+                const int orientation = exifOrientation(segment, count);
+                if (orientation != 1) info.orientation = orientation;
+                skip -= count;
+            }
+            if (skip > 0 && fseek(file, skip, SEEK_CUR) != 0) return false;
+        }
+    }
+
+    void runParallel(void* user, int count, void (*task)(void* arg, int index), void* arg) {
+        const ExecutionContext& ctx = *static_cast<const ExecutionContext*>(user);
+        parallelFor(ctx, 0, count, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                task(arg, i);
+            }
+        });
+    }
+
+    void appendToBuffer(void* context, void* data, int size) {
+        auto* buffer = static_cast<std::vector<uint8_t>*>(context);
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        buffer->insert(buffer->end(), bytes, bytes + size);
+    }
+
+    // 每條帶是一個 restart interval，各自從 DC 預測值歸零開始編碼，條帶間以 RSTn 標記串接
+    bool encodeStriped(int width, int height, int quality, const ExecutionContext& ctx,
+                       const McuRowEncoder& encodeRows, const ByteSink& sink) {
+        if (width <= 0 || height <= 0) {
+            throw std::invalid_argument("Invalid image dimensions.");
+        }
+        const int mcuHeight = stbi_write_jpg_mcu_height(quality);
+        const int mcuRows = (height + mcuHeight - 1) / mcuHeight;
+        const int mcuCols = (width + mcuHeight - 1) / mcuHeight;
+        const int threads = ctx.concurrency();
+
+        // 條帶數約為執行緒數的 4 倍以平衡負載，restart interval 以 MCU 個數計且不得超過 65535
+        int rowsPerStripe = mcuRows;
+        if (threads > 1 && mcuRows >= MIN_PARALLEL_MCU_ROWS && mcuCols <= 65535) {
+            rowsPerStripe = std::max(1, (mcuRows + threads * 4 - 1) / (threads * 4));
+            rowsPerStripe = std::min(rowsPerStripe, 65535 / mcuCols);
+        }
+        const int stripes = (mcuRows + rowsPerStripe - 1) / rowsPerStripe;
+
+        std::vector<std::vector<uint8_t>> encoded(stripes);
+        std::atomic<bool> failed{ false };
+        parallelFor(ctx, 0, stripes, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const int first = i * rowsPerStripe;
+                const int last = std::min(mcuRows, first + rowsPerStripe);
+                if (!encodeRows(first, last, encoded[i])) failed = true;
+            }
+        });
+
+        std::vector<uint8_t> header;
+        const int restartInterval = stripes > 1 ? mcuCols * rowsPerStripe : 0;
+        if (failed || !stbi_write_jpg_header_to_func(appendToBuffer, &header, width, height, 3, quality, restartInterval)) {
+            return false;
+        }
+
+        // RSTn 標記附加在前一條帶末尾，讓每條帶只呼叫一次 sink
+        for (int i = 0; i + 1 < stripes; i++) {
+            encoded[i].push_back(0xFF);
+            encoded[i].push_back(static_cast<uint8_t>(0xD0 + (i & 7)));
+        }
+        encoded[stripes - 1].push_back(0xFF);
+        encoded[stripes - 1].push_back(0xD9); // EOI
+
+        bool ok = sink(header.data(), header.size());
+        for (int i = 0; ok && i < stripes; i++) {
+            ok = sink(encoded[i].data(), encoded[i].size());
+        }
+        return ok;
+    }
+
+    void writeStriped(const std::string& filename, int width, int height, int quality,
+                      const ExecutionContext& ctx, const McuRowEncoder& encodeRows) {
+        std::unique_ptr<FILE, FileCloser> file(fopen(filename.c_str(), "wb"));
+        bool ok = file != nullptr && encodeStriped(width, height, quality, ctx, encodeRows,
+            [&](const uint8_t* data, size_t size) { return fwrite(data, 1, size, file.get()) == size; });
+        ok = file != nullptr && fclose(file.release()) == 0 && ok;
+        if (!ok) {
+            throw std::runtime_error("Failed to save image as JPEG: " + filename);
+        }
+    }
+}
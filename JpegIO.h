@@ -0,0 +1,44 @@
+#ifndef JPEG_IO_H
+#define JPEG_IO_H
+
+#include "ThreadPool.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct ImageInfo;
+
+// Image 與 YCbCrImage 共用的 JPEG 讀寫輔助函式
+namespace jpegio {
+    // 從 SOI 之後逐段掃描標記直到 SOF，只讀各段的長度欄位並跳過內容 (APP1 EXIF 只讀前 4 KB 取方向)
+    // 找不到 SOF 或格式錯誤時回傳 false
+    bool scanHeader(FILE* file, ImageInfo& info);
+
+    // 整個檔案讀進記憶體 (上限 INT_MAX 位元組)
+    bool readFile(const std::string& filename, std::vector<uint8_t>& bytes);
+
+    // stb_image 的 parallel_for 回呼，user 為 const ExecutionContext*
+    void runParallel(void* user, int count, void (*task)(void* arg, int index), void* arg);
+
+    // stb_image_write 的輸出回呼，context 為 std::vector<uint8_t>*
+    void appendToBuffer(void* context, void* data, int size);
+
+    // 把 MCU 列 [first, last) 的熵編碼資料附加到 out，失敗回傳 false
+    using McuRowEncoder = std::function<bool(int first, int last, std::vector<uint8_t>& out)>;
+
+    // 接收編碼輸出的回呼，寫入失敗回傳 false
+    using ByteSink = std::function<bool(const uint8_t* data, size_t size)>;
+
+    // 大型影像以 restart interval 切成條帶並行編碼後依序交給 sink (檔頭、各條帶與結尾各一次)
+    // 只有一條帶時不寫 DRI / RSTn 標記，輸出與 stbi_write_jpg 相同；失敗回傳 false
+    bool encodeStriped(int width, int height, int quality, const ExecutionContext& ctx,
+                       const McuRowEncoder& encodeRows, const ByteSink& sink);
+
+    // encodeStriped 寫入檔案，失敗時拋出例外
+    void writeStriped(const std::string& filename, int width, int height, int quality,
+                      const ExecutionContext& ctx, const McuRowEncoder& encodeRows);
+}
+
+#endif // JPEG_IO_H
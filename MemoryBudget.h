@@ -0,0 +1,85 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// 以位元組計算的准入控制：同時進行中的工作預估記憶體總和不超過上限
+// 依申請順序 (FIFO) 准入，大型工作不會被後到的小工作餓死；
+// 單一工作超過上限時，等到沒有其他工作進行中才准入
+class MemoryBudget {
+public:
+    // 准入憑證，解構或移動覆寫時歸還額度
+    class Reservation {
+    public:
+        Reservation() = default;
+        Reservation(MemoryBudget* budget, size_t bytes) : budget(budget), bytes(bytes) {}
+        Reservation(Reservation&& other) noexcept : budget(other.budget), bytes(other.bytes) { other.budget = nullptr; }
+        Reservation& operator=(Reservation&& other) noexcept {
+            if (this != &other) {
+                release();
+                budget = other.budget;
+                bytes = other.bytes;
+                other.budget = nullptr;
+            }
+            return *this;
+        }
+        Reservation(const Reservation&) = delete;
+        Reservation& operator=(const Reservation&) = delete;
+        ~Reservation() { release(); }
+
+        size_t getBytes() const { return budget ? bytes : 0; }
+
+        void release() {
+            if (budget) budget->release(bytes);
+            budget = nullptr;
+        }
+
+    private:
+        MemoryBudget* budget = nullptr;
+        size_t bytes = 0;
+    };
+
+    explicit MemoryBudget(size_t capacity) : capacity(capacity) {}
+
+    // 阻塞直到可以准入
+    Reservation acquire(size_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex);
+        const uint64_t ticket = nextTicket++;
+        changed.wait(lock, [&] {
+            return ticket == nowServing && (inUse + bytes <= capacity || inUse == 0);
+        });
+        nowServing++;
+        inUse += bytes;
+        peak = std::max(peak, inUse);
+        changed.notify_all();
+        return Reservation(this, bytes);
+    }
+
+    size_t getCapacity() const { return capacity; }
+
+    size_t getPeak() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peak;
+    }
+
+private:
+    void release(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        inUse -= bytes;
+        changed.notify_all();
+    }
+
+    const size_t capacity;
+    size_t inUse = 0;
+    size_t peak = 0;
+    uint64_t nextTicket = 0;
+    uint64_t nowServing = 0;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+#endif // MEMORY_BUDGET_H
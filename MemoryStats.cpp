@@ -0,0 +1,127 @@
+#include "MemoryStats.h"
+#include "Trace.h"
+#include <algorithm>
+#include <map>
+
+namespace memstats {
+    std::atomic<bool> active{ false };
+}
+
+namespace {
+    thread_local std::shared_ptr<memstats::Account> currentAccount;
+    thread_local const char* currentStage = nullptr;
+
+    const char* stageName(const char* stage) {
+        if (stage) return stage;
+        if (currentStage) return currentStage;
+        if (const char* scope = trace::currentScope()) return scope;
+        return "other";
+    }
+}
+
+namespace memstats {
+    void setEnabled(bool on) {
+        active.store(on, std::memory_order_relaxed);
+    }
+
+    void Account::add(const char* stage, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stage& entry = stages[stage];
+        entry.live += bytes;
+        entry.peak = std::max(entry.peak, entry.live);
+        entry.allocated += bytes;
+        entry.allocations++;
+
+        live += bytes;
+        if (live > peak) {
+            peak = live;
+            peakComposition.clear();
+            for (const auto& item : stages) {
+                if (item.second.live > 0) peakComposition.emplace_back(item.first, item.second.live);
+            }
+        }
+    }
+
+    void Account::remove(const char* stage, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stage& entry = stages[stage];
+        entry.live -= std::min(entry.live, bytes);
+        live -= std::min(live, bytes);
+    }
+
+    MemoryReport Account::report() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        MemoryReport result;
+        result.live = live;
+        result.peak = peak;
+
+        // 同名的字串常值在不同編譯單元可能位址不同，依內容合併
+        std::map<std::string, StageMemory> merged;
+        for (const auto& item : stages) {
+            StageMemory& stage = merged[item.first];
+            stage.stage = item.first;
+            stage.live += item.second.live;
+            stage.peak = std::max(stage.peak, item.second.peak);
+            stage.allocated += item.second.allocated;
+            stage.allocations += item.second.allocations;
+        }
+        for (auto& item : merged) result.stages.push_back(std::move(item.second));
+
+        std::map<std::string, size_t> composition;
+        for (const auto& item : peakComposition) composition[item.first] += item.second;
+        result.atPeak.assign(composition.begin(), composition.end());
+        std::sort(result.atPeak.begin(), result.atPeak.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+        return result;
+    }
+
+    void Account::reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        peak = live;
+        peakComposition.clear();
+        for (auto& item : stages) {
+            item.second.peak = item.second.live;
+            item.second.allocated = 0;
+            item.second.allocations = 0;
+            if (item.second.live > 0) peakComposition.emplace_back(item.first, item.second.live);
+        }
+    }
+
+    Account& global() {
+        static Account account;
+        return account;
+    }
+
+    AccountScope::AccountScope(std::shared_ptr<Account> account) : previous(std::move(currentAccount)) {
+        currentAccount = std::move(account);
+    }
+
+    AccountScope::~AccountScope() {
+        currentAccount = std::move(previous);
+    }
+
+    StageScope::StageScope(const char* stage) : previous(currentStage) {
+        currentStage = stage;
+    }
+
+    StageScope::~StageScope() {
+        currentStage = previous;
+    }
+
+    Allocation::Allocation(size_t size, const char* stageOverride) {
+        if (!enabled() || size == 0) return;
+        bytes = size;
+        stage = stageName(stageOverride);
+        job = currentAccount;
+        global().add(stage, bytes);
+        if (job) job->add(stage, bytes);
+    }
+
+    void Allocation::release() {
+        if (bytes > 0) {
+            global().remove(stage, bytes);
+            if (job) job->remove(stage, bytes);
+        }
+        bytes = 0;
+        job.reset();
+    }
+}
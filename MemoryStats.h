@@ -0,0 +1,131 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 影像像素緩衝區的記帳：目前與峰值的位元組數，依配置當下的區段分類
+// 區段取 StageScope 指定的名稱，否則取最內層的 TRACE_SCOPE (例如 "applyBlur"、"Image::decode")
+// 只計 Image / YCbCrImage 的像素與投影網格，不含 stb 的暫存區與壓縮資料；停用時不記帳
+namespace memstats {
+    extern std::atomic<bool> active;
+
+    inline bool enabled() { return active.load(std::memory_order_relaxed); }
+    void setEnabled(bool on);
+
+    struct StageMemory {
+        std::string stage;
+        size_t live = 0;          // 目前仍存在的位元組數
+        size_t peak = 0;          // 此區段自身的峰值
+        size_t allocated = 0;     // 累計配置的位元組數
+        uint64_t allocations = 0; // 累計配置次數
+    };
+
+    struct MemoryReport {
+        size_t live = 0;
+        size_t peak = 0;
+        std::vector<StageMemory> stages;                     // 依名稱排序
+        std::vector<std::pair<std::string, size_t>> atPeak; // 達到峰值當下各區段的用量 (由大到小)
+    };
+
+    // 一組配置的統計 (全域或 batch 的單一工作)
+    class Account {
+    public:
+        void add(const char* stage, size_t bytes);
+        void remove(const char* stage, size_t bytes);
+
+        MemoryReport report() const;
+        // 峰值重設為目前用量，累計值歸零
+        void reset();
+
+    private:
+        struct Stage {
+            size_t live = 0;
+            size_t peak = 0;
+            size_t allocated = 0;
+            uint64_t allocations = 0;
+        };
+
+        mutable std::mutex mutex;
+        size_t live = 0;
+        size_t peak = 0;
+        std::unordered_map<const char*, Stage> stages;
+        std::vector<std::pair<const char*, size_t>> peakComposition;
+    };
+
+    // 所有配置
+    Account& global();
+
+    // 目前執行緒之後的配置同時記到 account，解構時恢復
+    // (平行區塊中由工作執行緒配置的緩衝區不會記到 account)
+    class AccountScope {
+    public:
+        explicit AccountScope(std::shared_ptr<Account> account);
+        ~AccountScope();
+
+        AccountScope(const AccountScope&) = delete;
+        AccountScope& operator=(const AccountScope&) = delete;
+
+    private:
+        std::shared_ptr<Account> previous;
+    };
+
+    // 目前執行緒之後的配置一律歸到 stage，優先於 TRACE_SCOPE 的名稱 (stage 必須是字串常值)
+    class StageScope {
+    public:
+        explicit StageScope(const char* stage);
+        ~StageScope();
+
+        StageScope(const StageScope&) = delete;
+        StageScope& operator=(const StageScope&) = delete;
+
+    private:
+        const char* previous;
+    };
+
+    // 一個緩衝區的記帳憑證，跟著緩衝區複製、移動與解構
+    // 複製時以複製當下的區段重新記帳；記帳時停用的憑證不會退帳
+    class Allocation {
+    public:
+        Allocation() = default;
+        explicit Allocation(size_t bytes, const char* stage = nullptr);
+        Allocation(const Allocation& other) : Allocation(other.bytes) {}
+        Allocation(Allocation&& other) noexcept { take(other); }
+        Allocation& operator=(const Allocation& other) {
+            if (this != &other) *this = Allocation(other.bytes);
+            return *this;
+        }
+        Allocation& operator=(Allocation&& other) noexcept {
+            if (this != &other) {
+                release();
+                take(other);
+            }
+            return *this;
+        }
+        ~Allocation() { release(); }
+
+        size_t getBytes() const { return bytes; }
+        void release();
+
+    private:
+        void take(Allocation& other) {
+            bytes = other.bytes;
+            stage = other.stage;
+            job = std::move(other.job);
+            other.bytes = 0;
+        }
+
+        size_t bytes = 0;
+        const char* stage = nullptr;
+        std::shared_ptr<Account> job;
+    };
+}
+
+#endif // MEMORY_STATS_H
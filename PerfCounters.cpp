@@ -0,0 +1,240 @@
+#include "PerfCounters.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perfcounters {
+    std::atomic<bool> active{ false };
+}
+
+namespace {
+    using namespace perfcounters;
+
+    // 一個執行緒的計數器組與各區段的累計值；只有擁有者讀寫計數器，鎖只保護累計值
+    struct ThreadCounters {
+        std::mutex mutex;
+        uint32_t id = 0;
+        int fds[COUNTER_COUNT];
+        int slots[COUNTER_COUNT];  // 在群組讀值中的位置，-1: 不可用
+        int leader = -1;
+        int opened = 0;
+        uint64_t last[COUNTER_COUNT] = {};
+        std::vector<const char*> stack;
+        std::unordered_map<const char*, CounterValues> stages;
+
+        ThreadCounters() {
+            for (int i = 0; i < COUNTER_COUNT; i++) {
+                fds[i] = -1;
+                slots[i] = -1;
+            }
+        }
+
+        void open();
+        void close();
+        void read(uint64_t* values) const;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        // 執行緒結束後仍保留累計值 (計數器在執行緒結束時關閉)
+        std::vector<std::shared_ptr<ThreadCounters>> threads;
+        uint32_t nextId = 1;
+        int availableMask = -1; // 第一個執行緒開啟的結果，-1: 尚未嘗試
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+#ifdef __linux__
+    struct EventSpec {
+        uint32_t type;
+        uint64_t config;
+    };
+
+    const EventSpec kEvents[COUNTER_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    };
+#endif
+
+    // 依序嘗試各事件，第一個成功的當群組領頭；只量測使用者空間 (perf_event_paranoid 2 也可用)
+    void ThreadCounters::open() {
+#ifdef __linux__
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            perf_event_attr attr = {};
+            attr.size = sizeof(attr);
+            attr.type = kEvents[i].type;
+            attr.config = kEvents[i].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) continue;
+            if (leader < 0) leader = fd;
+            fds[i] = fd;
+            slots[i] = opened++;
+        }
+#endif
+    }
+
+    void ThreadCounters::close() {
+#ifdef __linux__
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (fds[i] >= 0) ::close(fds[i]);
+            fds[i] = -1;
+            slots[i] = -1;
+        }
+#endif
+        leader = -1;
+        opened = 0;
+    }
+
+    // 累計讀值；計數器被多工輪替時依啟用 / 實際執行時間比例換算
+    void ThreadCounters::read(uint64_t* values) const {
+        for (int i = 0; i < COUNTER_COUNT; i++) values[i] = 0;
+#ifdef __linux__
+        if (leader < 0) return;
+        uint64_t buffer[3 + COUNTER_COUNT];
+        if (::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + opened) * sizeof(uint64_t))) return;
+        const uint64_t timeEnabled = buffer[1];
+        const uint64_t timeRunning = buffer[2];
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (slots[i] < 0) continue;
+            uint64_t value = buffer[3 + slots[i]];
+            if (timeRunning > 0 && timeRunning < timeEnabled) {
+                value = static_cast<uint64_t>(static_cast<double>(value) * timeEnabled / timeRunning);
+            }
+            values[i] = value;
+        }
+#endif
+    }
+
+    // 執行緒結束時關閉計數器，累計值留在登錄表中
+    struct ThreadHandle {
+        std::shared_ptr<ThreadCounters> counters;
+        ~ThreadHandle() {
+            if (counters) counters->close();
+        }
+    };
+
+    ThreadCounters& currentThread() {
+        thread_local ThreadHandle handle;
+        if (!handle.counters) {
+            handle.counters = std::make_shared<ThreadCounters>();
+            handle.counters->open();
+
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            handle.counters->id = reg.nextId++;
+            if (reg.availableMask < 0) {
+                reg.availableMask = 0;
+                for (int i = 0; i < COUNTER_COUNT; i++) {
+                    if (handle.counters->slots[i] >= 0) reg.availableMask |= 1 << i;
+                }
+            }
+            reg.threads.push_back(handle.counters);
+        }
+        return *handle.counters;
+    }
+
+    // 上次讀值到現在的差值計入最內層的區段
+    void attribute(ThreadCounters& thread, const uint64_t* now) {
+        if (!thread.stack.empty()) {
+            CounterValues& stage = thread.stages[thread.stack.back()];
+            for (int i = 0; i < COUNTER_COUNT; i++) {
+                stage.values[i] += now[i] - std::min(now[i], thread.last[i]);
+            }
+        }
+        for (int i = 0; i < COUNTER_COUNT; i++) thread.last[i] = now[i];
+    }
+}
+
+namespace perfcounters {
+    const char* counterName(Counter counter) {
+        static const char* const names[COUNTER_COUNT] = { "cycles", "instructions", "cache-misses", "dTLB-load-misses", "page-faults" };
+        return names[counter];
+    }
+
+    bool setEnabled(bool on) {
+        bool any = true;
+        if (on) {
+            const ThreadCounters& thread = currentThread();
+            any = thread.opened > 0;
+        }
+        active.store(on, std::memory_order_relaxed);
+        return any;
+    }
+
+    bool available(Counter counter) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        return reg.availableMask > 0 && (reg.availableMask & (1 << counter)) != 0;
+    }
+
+    std::vector<StageCounters> snapshot() {
+        std::vector<StageCounters> result;
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& thread : reg.threads) {
+            std::lock_guard<std::mutex> threadLock(thread->mutex);
+            // 同名的字串常值在不同編譯單元可能位址不同，依內容合併
+            std::map<std::string, CounterValues> merged;
+            for (const auto& entry : thread->stages) merged[entry.first] += entry.second;
+            for (const auto& entry : merged) result.push_back({ entry.first, thread->id, entry.second });
+        }
+        return result;
+    }
+
+    std::vector<StageCounters> totals() {
+        std::map<std::string, CounterValues> merged;
+        for (const auto& entry : snapshot()) merged[entry.stage] += entry.counts;
+        std::vector<StageCounters> result;
+        for (const auto& entry : merged) result.push_back({ entry.first, 0, entry.second });
+        return result;
+    }
+
+    void reset() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& thread : reg.threads) {
+            std::lock_guard<std::mutex> threadLock(thread->mutex);
+            thread->stages.clear();
+        }
+    }
+
+    void enter(const char* stage) {
+        ThreadCounters& thread = currentThread();
+        uint64_t now[COUNTER_COUNT];
+        thread.read(now);
+
+        std::lock_guard<std::mutex> lock(thread.mutex);
+        attribute(thread, now);
+        thread.stages[stage].calls++;
+        thread.stack.push_back(stage);
+    }
+
+    void leave() {
+        ThreadCounters& thread = currentThread();
+        uint64_t now[COUNTER_COUNT];
+        thread.read(now);
+
+        std::lock_guard<std::mutex> lock(thread.mutex);
+        attribute(thread, now);
+        if (!thread.stack.empty()) thread.stack.pop_back();
+    }
+}
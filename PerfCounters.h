@@ -0,0 +1,65 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 硬體效能計數器：每個執行緒各開一組 perf_event_open 計數器，在 TRACE_SCOPE 的邊界讀取，
+// 差值計入目前最內層的區段 (自身計數，不含巢狀的子區段)
+// 只支援 Linux；核心或虛擬機不提供某個事件時該欄位標記為不可用，其餘照常計數
+namespace perfcounters {
+    enum Counter {
+        Cycles,
+        Instructions,
+        CacheMisses,  // 最後一級快取未命中
+        DtlbMisses,   // 資料 TLB 讀取未命中
+        PageFaults,   // 軟體事件，沒有 PMU 的機器也可用
+        COUNTER_COUNT
+    };
+
+    const char* counterName(Counter counter);
+
+    struct CounterValues {
+        uint64_t values[COUNTER_COUNT] = {};
+        uint64_t calls = 0; // 進入區段的次數
+
+        CounterValues& operator+=(const CounterValues& other) {
+            for (int i = 0; i < COUNTER_COUNT; i++) values[i] += other.values[i];
+            calls += other.calls;
+            return *this;
+        }
+        uint64_t operator[](Counter counter) const { return values[counter]; }
+    };
+
+    // 一個執行緒在一個區段的累計值
+    struct StageCounters {
+        std::string stage;
+        uint32_t thread = 0; // 執行緒的註冊順序
+        CounterValues counts;
+    };
+
+    extern std::atomic<bool> active;
+
+    inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    // 開啟時在目前執行緒嘗試建立計數器組，完全無法使用時回傳 false (仍然啟用，只是全為 0)
+    bool setEnabled(bool on);
+
+    // 第一個建立計數器的執行緒實際開啟成功的事件
+    bool available(Counter counter);
+
+    // 各執行緒各區段的累計值 / 依區段加總所有執行緒
+    std::vector<StageCounters> snapshot();
+    std::vector<StageCounters> totals();
+
+    // 清除累計值 (計數器保持開啟)
+    void reset();
+
+    // 由 trace::Scope 呼叫
+    void enter(const char* stage);
+    void leave();
+}
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,183 @@
+#include "Pipeline.h"
+#include "FilterKernels.h"
+#include "TileExecutor.h"
+#include "Trace.h"
+#include <algorithm>
+#include <memory>
+
+namespace ops {
+    Op brightness(int brightness) { return { Op::Kind::Brightness, brightness, 0.0f }; }
+    Op contrast(float contrast) { return { Op::Kind::Contrast, 0, contrast }; }
+    Op saturation(float saturation) { return { Op::Kind::Saturation, 0, saturation }; }
+    Op colorTemperature(int temperature) { return { Op::Kind::ColorTemperature, temperature, 0.0f }; }
+    Op invert() { return { Op::Kind::Invert, 0, 0.0f }; }
+    Op grayscale() { return { Op::Kind::Grayscale, 0, 0.0f }; }
+    Op blur(int radius) { return { Op::Kind::Blur, radius, 0.0f }; }
+}
+
+namespace {
+    using ops::Op;
+
+    // 合併後點運算中的一步
+    struct FusedStep {
+        enum class Type { Lut, Saturation, Grayscale };
+        Type type = Type::Lut;
+        std::vector<uint8_t> lut; // 256 個「像素」，第 v 個像素的第 c 通道為輸入值 v 在通道 c 的輸出
+        bool uniform = false;     // 所有通道共用同一張表
+        float saturation = 0.0f;
+
+        explicit FusedStep(Type type) : type(type) {}
+    };
+
+    bool isPointOp(const Op& op) {
+        return op.kind != Op::Kind::Blur;
+    }
+
+    // 逐通道獨立的運算可以直接套用在 LUT 上 (把 LUT 當成 256 個像素)，合成結果與逐一執行完全相同
+    void applyToLut(const Op& op, std::vector<uint8_t>& lut, int channels) {
+        switch (op.kind) {
+        case Op::Kind::Brightness:
+            brightnessRow(lut.data(), lut.data(), lut.size(), op.intValue);
+            break;
+        case Op::Kind::Contrast:
+            contrastRow(lut.data(), lut.data(), lut.size(), op.floatValue);
+            break;
+        case Op::Kind::Invert:
+            invertRow(lut.data(), lut.data(), lut.size());
+            break;
+        case Op::Kind::ColorTemperature:
+            colorTemperatureRow(lut.data(), lut.data(), 256, channels, op.intValue);
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool isLutOp(const Op& op, int channels) {
+        switch (op.kind) {
+        case Op::Kind::Brightness:
+        case Op::Kind::Contrast:
+        case Op::Kind::Invert:
+        case Op::Kind::ColorTemperature:
+            return true;
+        case Op::Kind::Saturation:
+        case Op::Kind::Grayscale:
+            return channels < 3; // 非 RGB 影像為恆等運算
+        default:
+            return false;
+        }
+    }
+
+    std::vector<FusedStep> fusePointOps(std::vector<Op>::const_iterator begin, std::vector<Op>::const_iterator end, int channels) {
+        std::vector<FusedStep> steps;
+        for (auto it = begin; it != end; ++it) {
+            if (isLutOp(*it, channels)) {
+                if (steps.empty() || steps.back().type != FusedStep::Type::Lut) {
+                    FusedStep step(FusedStep::Type::Lut);
+                    step.lut.resize(256 * channels);
+                    for (int v = 0; v < 256; v++) {
+                        std::fill_n(step.lut.begin() + v * channels, channels, static_cast<uint8_t>(v));
+                    }
+                    steps.push_back(std::move(step));
+                }
+                applyToLut(*it, steps.back().lut, channels);
+            }
+            else if (it->kind == Op::Kind::Saturation) {
+                FusedStep step(FusedStep::Type::Saturation);
+                step.saturation = it->floatValue;
+                steps.push_back(std::move(step));
+            }
+            else {
+                steps.emplace_back(FusedStep::Type::Grayscale);
+            }
+        }
+
+        for (auto& step : steps) {
+            if (step.type != FusedStep::Type::Lut) continue;
+            step.uniform = true;
+            for (int v = 0; v < 256 && step.uniform; v++) {
+                for (int c = 1; c < channels; c++) {
+                    if (step.lut[v * channels + c] != step.lut[v * channels]) {
+                        step.uniform = false;
+                        break;
+                    }
+                }
+            }
+            if (step.uniform) { // 壓縮成單通道表
+                std::vector<uint8_t> table(256);
+                for (int v = 0; v < 256; v++) table[v] = step.lut[v * channels];
+                step.lut.swap(table);
+            }
+        }
+        return steps;
+    }
+
+    void applyLutRow(const FusedStep& step, const uint8_t* src, uint8_t* dst, int pixels, int channels) {
+        const uint8_t* lut = step.lut.data();
+        const size_t count = static_cast<size_t>(pixels) * channels;
+        if (step.uniform) {
+            for (size_t i = 0; i < count; i++) {
+                dst[i] = lut[src[i]];
+            }
+            return;
+        }
+        for (size_t i = 0; i < count; i += channels) {
+            for (int c = 0; c < channels; c++) {
+                dst[i + c] = lut[src[i + c] * channels + c];
+            }
+        }
+    }
+
+    // 一段連續點運算合併成的單一階段：第一步由 src 讀入，其餘步驟在輸出列上就地執行
+    TileStage fusedStage(std::vector<FusedStep> fused) {
+        auto steps = std::make_shared<const std::vector<FusedStep>>(std::move(fused));
+        TileStage stage;
+        stage.halo = 0;
+        stage.run = [steps](const PixelRegion& src, const PixelRegion& dst, int, int) {
+            const int channels = dst.channels;
+            for (int y = dst.y; y < dst.y + dst.height; y++) {
+                const uint8_t* in = src.pixel(dst.x, y);
+                uint8_t* out = dst.row(y);
+                for (const FusedStep& step : *steps) {
+                    switch (step.type) {
+                    case FusedStep::Type::Lut:
+                        applyLutRow(step, in, out, dst.width, channels);
+                        break;
+                    case FusedStep::Type::Saturation:
+                        saturationRow(in, out, dst.width, channels, step.saturation);
+                        break;
+                    case FusedStep::Type::Grayscale:
+                        grayscaleRow(in, out, dst.width, channels, false);
+                        break;
+                    }
+                    in = out;
+                }
+            }
+        };
+        return stage;
+    }
+}
+
+Image Pipeline::evaluate(const ExecutionContext& ctx) const {
+    TRACE_SCOPE("Pipeline::evaluate");
+    const int channels = source->getChannels();
+
+    std::vector<TileStage> stages;
+    auto it = operations.begin();
+    while (it != operations.end()) {
+        if (!isPointOp(*it)) {
+            if (it->intValue > 0) {
+                stages.push_back(blurStage(it->intValue));
+            }
+            ++it;
+            continue;
+        }
+
+        auto segmentEnd = std::find_if(it, operations.end(), [](const Op& op) { return !isPointOp(op); });
+        stages.push_back(fusedStage(fusePointOps(it, segmentEnd, channels)));
+        it = segmentEnd;
+    }
+
+    if (stages.empty()) return *source;
+    return runTiled(*source, stages, ctx);
+}
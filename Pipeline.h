@@ -0,0 +1,60 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "Image.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// 管線中的運算 (只記錄參數，求值時才執行)
+namespace ops {
+    struct Op {
+        enum class Kind { Brightness, Contrast, Saturation, ColorTemperature, Invert, Grayscale, Blur };
+        Kind kind;
+        int intValue = 0;
+        float floatValue = 0.0f;
+    };
+
+    Op brightness(int brightness);
+    Op contrast(float contrast);
+    Op saturation(float saturation);
+    Op colorTemperature(int temperature);
+    Op invert();
+    Op grayscale(); // 灰階值複製到 RGB 通道
+    Op blur(int radius);
+}
+
+// 延遲求值的影像處理管線
+//   using namespace ops;
+//   Image out = pipeline(img) | brightness(10) | contrast(1.2f) | saturation(0.8f) | blur(3);
+// 求值時連續的點運算合併成單一核心 (可查表的運算合成一張 LUT)，鄰域運算交給分塊執行器
+// 管線只保存來源影像的參考，來源影像必須存活到求值為止
+class Pipeline {
+public:
+    explicit Pipeline(const Image& source) : source(&source) {}
+
+    Pipeline& append(const ops::Op& op) {
+        operations.push_back(op);
+        return *this;
+    }
+
+    const std::vector<ops::Op>& getOperations() const { return operations; }
+
+    // 執行管線
+    Image evaluate(const ExecutionContext& ctx = ExecutionContext::defaultContext()) const;
+    operator Image() const { return evaluate(); }
+
+private:
+    const Image* source;
+    std::vector<ops::Op> operations;
+};
+
+inline Pipeline pipeline(const Image& img) {
+    return Pipeline(img);
+}
+
+inline Pipeline operator|(Pipeline p, const ops::Op& op) {
+    p.append(op);
+    return p;
+}
+
+#endif // PIPELINE_H
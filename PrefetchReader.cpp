@@ -0,0 +1,337 @@
+#include "PrefetchReader.h"
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define PREFETCH_HAS_IO_URING 1
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace {
+    struct FileCloser {
+        void operator()(FILE* f) const { fclose(f); }
+    };
+
+    // 呼叫端由 index 得知路徑，訊息只描述原因
+    std::string readError(int error) {
+        return std::string("Failed to read file: ") + std::strerror(error);
+    }
+}
+
+#ifdef PREFETCH_HAS_IO_URING
+
+// 不依賴 liburing 的最小 io_uring 包裝：直接以系統呼叫建立並映射提交 / 完成佇列
+// 只由背景執行緒使用，不需要鎖
+class PrefetchReader::IoUring {
+public:
+    ~IoUring() {
+        if (fd >= 0) close(fd);
+        retained.clear();
+        if (sqes) munmap(sqes, sqesBytes);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqBytes);
+        if (sqRing) munmap(sqRing, sqBytes);
+    }
+
+    // 核心不支援、被 seccomp 擋下或資源不足時回傳 false
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+
+        sqBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) sqBytes = cqBytes = std::max(sqBytes, cqBytes);
+
+        sqRing = mapRing(sqBytes, IORING_OFF_SQ_RING);
+        if (!sqRing) return false;
+        cqRing = singleMap ? sqRing : mapRing(cqBytes, IORING_OFF_CQ_RING);
+        if (!cqRing) return false;
+        sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mapRing(sqesBytes, IORING_OFF_SQES));
+        if (!sqes) return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // 排入一個 readv 請求 (5.1 起支援)；提交佇列已滿時回傳 false
+    bool queueRead(int file, const iovec* iov, uint64_t offset, uint64_t userData) {
+        const unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) return false;
+        const unsigned slot = tail & sqMask;
+        io_uring_sqe& sqe = sqes[slot];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<uint64_t>(iov);
+        sqe.len = 1;
+        sqe.off = offset;
+        sqe.user_data = userData;
+        sqArray[slot] = slot;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        pending++;
+        return true;
+    }
+
+    // 提交排入的請求並等待至少 waitCount 個完成
+    bool submitAndWait(unsigned waitCount) {
+        for (;;) {
+            const long result = syscall(__NR_io_uring_enter, fd, pending, waitCount,
+                                        waitCount > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (result >= 0) {
+                pending -= static_cast<unsigned>(result);
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+        }
+    }
+
+    // 核心可能仍在寫入的緩衝區，等 ring 關閉後才釋放
+    void retain(BufferPool::Buffer buffer) { retained.push_back(std::move(buffer)); }
+
+    bool popCompletion(io_uring_cqe& cqe) {
+        const unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+        cqe = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void* mapRing(size_t bytes, off_t offset) {
+        void* address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+
+    int fd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqBytes = 0, cqBytes = 0, sqesBytes = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0, sqEntries = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned pending = 0; // 已排入尚未提交的請求數
+    std::vector<BufferPool::Buffer> retained;
+};
+
+#else
+
+class PrefetchReader::IoUring {
+};
+
+#endif
+
+PrefetchReader::PrefetchReader(std::vector<std::string> paths, int depth, int ioThreads)
+    : paths(std::move(paths)), depth(std::max(1, depth)), pool(static_cast<size_t>(std::max(1, depth)) * 2),
+      ready(static_cast<size_t>(std::max(1, depth))) {
+#ifdef PREFETCH_HAS_IO_URING
+    std::unique_ptr<IoUring> candidate(new IoUring());
+    if (candidate->init(static_cast<unsigned>(this->depth))) {
+        ring = std::move(candidate);
+        threads.emplace_back([this] { runIoUring(); });
+        return;
+    }
+#endif
+    const int count = std::max(1, ioThreads);
+    activeThreads = count;
+    for (int i = 0; i < count; i++) {
+        threads.emplace_back([this] { runThread(); });
+    }
+}
+
+PrefetchReader::~PrefetchReader() {
+    ready.close(); // 提前結束時讓背景執行緒停止讀取
+    for (auto& t : threads) t.join();
+}
+
+bool PrefetchReader::next(PrefetchedFile& file) {
+    return ready.pop(file);
+}
+
+PrefetchedFile PrefetchReader::readWithStdio(size_t index) {
+    PrefetchedFile file;
+    file.index = index;
+    std::unique_ptr<FILE, FileCloser> f(fopen(paths[index].c_str(), "rb"));
+    if (!f) {
+        file.error = readError(errno);
+        return file;
+    }
+    long size = -1;
+    if (fseek(f.get(), 0, SEEK_END) != 0 || (size = ftell(f.get())) < 0 || fseek(f.get(), 0, SEEK_SET) != 0) {
+        file.error = readError(errno);
+        return file;
+    }
+    if (size > INT_MAX) {
+        file.error = readError(EFBIG);
+        return file;
+    }
+    file.data = pool.acquire(static_cast<size_t>(size));
+    file.data.shrink(fread(file.data.data(), 1, file.data.size(), f.get()));
+    if (ferror(f.get())) {
+        file.error = readError(EIO); // 不把讀到一半的內容當成完整檔案交出
+    }
+    return file;
+}
+
+// I/O 執行緒：各自取下一個檔案，fread 整個讀入
+void PrefetchReader::runThread() {
+    size_t index;
+    while ((index = nextPath.fetch_add(1)) < paths.size()) {
+        if (!ready.push(readWithStdio(index))) break;
+    }
+    if (--activeThreads == 0) ready.close();
+}
+
+#ifdef PREFETCH_HAS_IO_URING
+
+// io_uring 背景執行緒：維持最多 depth 個檔案同時讀取，讀完 (含短讀後補讀) 即交出
+void PrefetchReader::runIoUring() {
+    struct Slot {
+        PrefetchedFile file;
+        int fd = -1;
+        size_t done = 0;
+        iovec iov;
+        bool busy = false;
+    };
+    // 單次讀取上限，避免超過 readv 的長度限制
+    const size_t maxChunk = 1 << 30;
+
+    std::vector<Slot> slots(depth);
+    int inFlight = 0;
+    bool stopping = false;
+
+    auto queueChunk = [&](int s) {
+        Slot& slot = slots[s];
+        slot.iov.iov_base = slot.file.data.data() + slot.done;
+        slot.iov.iov_len = std::min(slot.file.data.size() - slot.done, maxChunk);
+        return ring->queueRead(slot.fd, &slot.iov, slot.done, static_cast<uint64_t>(s));
+    };
+    auto finish = [&](int s) {
+        Slot& slot = slots[s];
+        close(slot.fd);
+        slot.fd = -1;
+        slot.busy = false;
+        inFlight--;
+        if (!stopping && !ready.push(std::move(slot.file))) stopping = true;
+        slot.file = PrefetchedFile();
+    };
+
+    size_t index = 0;
+    for (;;) {
+        // 補滿空的槽位；開檔與取大小仍是同步呼叫，但遠比讀取內容便宜
+        for (int s = 0; s < depth && !stopping && index < paths.size(); s++) {
+            if (slots[s].busy) continue;
+            PrefetchedFile file;
+            file.index = index;
+            const std::string& path = paths[index++];
+            const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            int error = 0;
+            if (fd < 0 || fstat(fd, &st) != 0) error = errno;
+            else if (st.st_size > INT_MAX) error = EFBIG;
+            if (error) {
+                file.error = readError(error);
+                if (fd >= 0) close(fd);
+                if (!ready.push(std::move(file))) stopping = true;
+                s--; // 同一個槽位換下一個檔案
+                continue;
+            }
+            file.data = pool.acquire(static_cast<size_t>(st.st_size));
+            Slot& slot = slots[s];
+            slot.file = std::move(file);
+            slot.fd = fd;
+            slot.done = 0;
+            slot.busy = true;
+            inFlight++;
+            if (slot.file.data.size() == 0) {
+                finish(s); // 空檔案直接交出，由解碼端回報錯誤
+            }
+            else if (!queueChunk(s)) {
+                slot.file.error = readError(EIO);
+                finish(s);
+            }
+        }
+        if (inFlight == 0) {
+            if (stopping || index >= paths.size()) break;
+            continue; // 這一輪的檔案都不需要讀取 (空檔案或開檔失敗)
+        }
+
+        if (!ring->submitAndWait(1)) {
+            // io_uring_enter 失敗 (例如被 seccomp 擋下)：未完成與尚未開始的檔案改用 fread 讀取
+            std::vector<size_t> remaining;
+            for (int s = 0; s < depth; s++) {
+                if (!slots[s].busy) continue;
+                remaining.push_back(slots[s].file.index);
+                ring->retain(std::move(slots[s].file.data));
+                close(slots[s].fd);
+                slots[s] = Slot();
+            }
+            while (index < paths.size()) remaining.push_back(index++);
+            for (size_t i : remaining) {
+                if (stopping || !ready.push(readWithStdio(i))) stopping = true;
+            }
+            break;
+        }
+
+        io_uring_cqe cqe;
+        while (ring->popCompletion(cqe)) {
+            const int s = static_cast<int>(cqe.user_data);
+            Slot& slot = slots[s];
+            if (cqe.res > 0) {
+                slot.done += static_cast<size_t>(cqe.res);
+            }
+            else if (cqe.res == 0) {
+                slot.file.data.shrink(slot.done); // 讀取途中檔案被截斷
+            }
+            else if (cqe.res != -EINTR && cqe.res != -EAGAIN) {
+                slot.file.error = readError(-cqe.res);
+            }
+
+            const bool complete = slot.done >= slot.file.data.size() || !slot.file.ok() || cqe.res == 0;
+            if (complete || stopping) {
+                finish(s);
+            }
+            else if (!queueChunk(s)) {
+                // 無法送出剩下的讀取：回報錯誤，不把讀到一半的內容當成完整檔案交出
+                slot.file.error = readError(EIO);
+                finish(s);
+            }
+        }
+    }
+    ready.close();
+}
+
+#else
+
+void PrefetchReader::runIoUring() {
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef PREFETCH_READER_H
+#define PREFETCH_READER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+#include "BufferPool.h"
+
+// 預先讀入的整個檔案
+struct PrefetchedFile {
+    size_t index = 0;          // 在輸入清單中的位置
+    BufferPool::Buffer data;   // 檔案內容，用完即歸還給池
+    std::string error;         // 非空表示讀取失敗
+
+    bool ok() const { return error.empty(); }
+};
+
+// 在解碼執行緒之前把輸入檔整個讀進池化的緩衝區，解碼端只處理記憶體中的資料
+// Linux 上以 io_uring 同時發出多個讀取請求 (由單一背景執行緒提交與收割)；
+// 核心不支援或被禁用時，改由數個專用 I/O 執行緒以 fread 讀取
+// 檔案依讀完的順序交出，不保證與清單順序相同
+class PrefetchReader {
+public:
+    // depth: 同時讀取中的檔案數，也是已讀完但尚未取走的檔案數上限
+    explicit PrefetchReader(std::vector<std::string> paths, int depth = 8, int ioThreads = 2);
+    ~PrefetchReader();
+
+    PrefetchReader(const PrefetchReader&) = delete;
+    PrefetchReader& operator=(const PrefetchReader&) = delete;
+
+    // 阻塞直到有檔案讀完；全部交出後回傳 false
+    bool next(PrefetchedFile& file);
+
+    bool usingIoUring() const { return ring != nullptr; }
+
+private:
+    class IoUring;
+
+    void runIoUring();
+    void runThread();
+    PrefetchedFile readWithStdio(size_t index);
+
+    const std::vector<std::string> paths;
+    const int depth;
+    BufferPool pool;
+    BoundedQueue<PrefetchedFile> ready;
+    std::atomic<size_t> nextPath{ 0 };
+    std::atomic<int> activeThreads{ 0 };
+    std::vector<std::thread> threads;
+    std::unique_ptr<IoUring> ring; // nullptr 表示使用 I/O 執行緒
+};
+
+#endif // PREFETCH_READER_H
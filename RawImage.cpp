@@ -0,0 +1,121 @@
+#include "RawImage.h"
+#include "Image.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char RAW_MAGIC[8] = { 'R', 'A', 'W', 'I', 'M', 'G', '\0', '\1' };
+
+    // 像素資料對齊到 4096 與系統頁大小中較大者，映射後的列指標即頁對齊
+    uint32_t dataAlignment() {
+#if defined(__unix__) || defined(__APPLE__)
+        const long page = sysconf(_SC_PAGESIZE);
+        if (page > 4096) return static_cast<uint32_t>(page);
+#endif
+        return 4096;
+    }
+
+    struct FileCloser {
+        void operator()(FILE* f) const { fclose(f); }
+    };
+}
+
+MappedFile::~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+        return;
+    }
+#endif
+    delete[] bytes;
+}
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filename) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* address = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // 映射建立後即可關閉檔案描述符
+    if (address == MAP_FAILED) return nullptr;
+    file->bytes = static_cast<const uint8_t*>(address);
+    file->length = static_cast<size_t>(st.st_size);
+    file->mapped = true;
+#else
+    std::unique_ptr<FILE, FileCloser> f(fopen(filename.c_str(), "rb"));
+    if (!f || fseek(f.get(), 0, SEEK_END) != 0) return nullptr;
+    const long size = ftell(f.get());
+    if (size <= 0 || fseek(f.get(), 0, SEEK_SET) != 0) return nullptr;
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+    if (fread(buffer.get(), 1, static_cast<size_t>(size), f.get()) != static_cast<size_t>(size)) return nullptr;
+    file->bytes = buffer.release();
+    file->length = static_cast<size_t>(size);
+#endif
+    return file;
+}
+
+namespace rawimage {
+    bool readHeader(const MappedFile& file, RawImageHeader& header) {
+        if (file.size() < sizeof(RawImageHeader)) return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0 || header.pixelType != RAW_PIXEL_U8) return false;
+        if (header.width == 0 || header.height == 0 || header.width > INT32_MAX || header.height > INT32_MAX) return false;
+        if (header.channels != 1 && header.channels != 3 && header.channels != 4) return false;
+        if (header.pitch < static_cast<uint64_t>(header.width) * header.channels) return false;
+        if (header.dataOffset < sizeof(RawImageHeader) + header.sourcePathBytes) return false;
+        // 最後一列只需要 width * channels 位元組
+        const uint64_t needed = header.dataOffset + header.pitch * (header.height - 1)
+                              + static_cast<uint64_t>(header.width) * header.channels;
+        return needed <= file.size();
+    }
+
+    bool matches(const MappedFile& file, const SourceKey& key) {
+        RawImageHeader header;
+        if (!readHeader(file, header)) return false;
+        if (header.sourceSize != key.size || header.sourceMtime != key.mtime || header.sourcePathBytes != key.path.size()) return false;
+        return std::memcmp(file.data() + sizeof(RawImageHeader), key.path.data(), key.path.size()) == 0;
+    }
+
+    bool write(const std::string& filename, const Image& img, const SourceKey* source) {
+        const uint32_t alignment = dataAlignment();
+        const size_t pathBytes = source ? source->path.size() : 0;
+
+        RawImageHeader header = {};
+        std::memcpy(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+        header.dataOffset = static_cast<uint32_t>((sizeof(RawImageHeader) + pathBytes + alignment - 1) / alignment * alignment);
+        header.pixelType = RAW_PIXEL_U8;
+        header.width = static_cast<uint32_t>(img.getWidth());
+        header.height = static_cast<uint32_t>(img.getHeight());
+        header.channels = static_cast<uint32_t>(img.getChannels());
+        header.sourcePathBytes = static_cast<uint32_t>(pathBytes);
+        header.pitch = static_cast<uint64_t>(img.getWidth()) * img.getChannels();
+        if (source) {
+            header.sourceSize = source->size;
+            header.sourceMtime = source->mtime;
+        }
+
+        std::vector<uint8_t> prefix(header.dataOffset, 0);
+        std::memcpy(prefix.data(), &header, sizeof(header));
+        if (source) {
+            std::copy(source->path.begin(), source->path.end(), prefix.begin() + sizeof(header));
+        }
+
+        std::unique_ptr<FILE, FileCloser> file(fopen(filename.c_str(), "wb"));
+        bool ok = file != nullptr && fwrite(prefix.data(), 1, prefix.size(), file.get()) == prefix.size();
+        ok = ok && fwrite(img.pixels(), 1, img.byteSize(), file.get()) == img.byteSize();
+        return file != nullptr && fclose(file.release()) == 0 && ok;
+    }
+}
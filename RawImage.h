@@ -0,0 +1,67 @@
+#ifndef RAW_IMAGE_H
+#define RAW_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class Image;
+
+// 原始像素容器：固定大小的檔頭後接頁對齊的像素資料，可以唯讀映射後直接當作 Image 使用
+// 所有欄位皆為本機位元組序 (快取檔不跨機器共用)
+struct RawImageHeader {
+    char magic[8];            // "RAWIMG" + 版本
+    uint32_t dataOffset;      // 像素資料起點 (頁大小的倍數，至少 4096)
+    uint32_t pixelType;       // 像素型別 (目前只有 RAW_PIXEL_U8)
+    uint32_t width;           // 影像寬度
+    uint32_t height;          // 影像高度
+    uint32_t channels;        // 通道數
+    uint32_t sourcePathBytes; // 檔頭之後的來源路徑長度 (快取用，0: 無)
+    uint64_t pitch;           // 每列位元組數 (>= width * channels)
+    uint64_t sourceSize;      // 來源檔案大小 (快取用)
+    int64_t sourceMtime;      // 來源檔案修改時間 (快取用)
+};
+
+const uint32_t RAW_PIXEL_U8 = 1;
+
+// 唯讀映射的檔案，最後一個持有者釋放時解除映射
+class MappedFile {
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false; // false: 不支援 mmap 的平台上以 new[] 讀入
+
+    MappedFile() = default;
+
+public:
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 開啟失敗回傳 nullptr
+    static std::shared_ptr<const MappedFile> open(const std::string& filename);
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+namespace rawimage {
+    // 快取比對用的來源資訊
+    struct SourceKey {
+        std::string path;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+    };
+
+    // 檢查檔頭與檔案長度，成功時填入 header
+    bool readHeader(const MappedFile& file, RawImageHeader& header);
+
+    // 檔頭中記錄的來源與 key 完全相同
+    bool matches(const MappedFile& file, const SourceKey& key);
+
+    // 寫出原始像素檔，source 不為 nullptr 時一併記錄來源資訊，失敗回傳 false
+    bool write(const std::string& filename, const Image& img, const SourceKey* source = nullptr);
+}
+
+#endif // RAW_IMAGE_H
@@ -0,0 +1,291 @@
+#include "ReferenceFilters.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+    uint8_t clampByte(int value) {
+        return static_cast<uint8_t>(std::clamp(value, 0, 255));
+    }
+
+    // 每個位元組各自轉換
+    template <typename Fn>
+    Image mapBytes(const Image& img, Fn fn) {
+        Image result(img.getWidth(), img.getHeight(), img.getChannels());
+        const uint8_t* src = img.pixels();
+        uint8_t* dst = result.mutablePixels();
+        for (size_t i = 0; i < img.byteSize(); i++) {
+            dst[i] = fn(src[i]);
+        }
+        return result;
+    }
+}
+
+namespace reference {
+    Image grayscale(const Image& img, GrayscaleMode mode) {
+        if (img.getChannels() < 3) return img;
+
+        const int channels = img.getChannels();
+        const bool singleChannel = (mode == GrayscaleMode::SingleChannel);
+        Image result(img.getWidth(), img.getHeight(), singleChannel ? 1 : channels);
+        const uint8_t* src = img.pixels();
+        uint8_t* dst = result.mutablePixels();
+        const size_t pixels = static_cast<size_t>(img.getWidth()) * img.getHeight();
+        for (size_t i = 0; i < pixels; i++) {
+            const uint8_t* p = src + i * channels;
+            // 最佳化前的雙精度公式 (截斷)
+            const uint8_t gray = static_cast<uint8_t>(0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2]);
+            if (singleChannel) {
+                dst[i] = gray;
+                continue;
+            }
+            uint8_t* q = dst + i * channels;
+            q[0] = q[1] = q[2] = gray;
+            if (channels == 4) q[3] = p[3];
+        }
+        return result;
+    }
+
+    Image blur(const Image& img, int radius) {
+        if (radius <= 0) return img;
+
+        const int width = img.getWidth();
+        const int height = img.getHeight();
+        const int channels = img.getChannels();
+        const int count = (2 * radius + 1) * (2 * radius + 1);
+        Image result(width, height, channels);
+        const uint8_t* src = img.pixels();
+        uint8_t* dst = result.mutablePixels();
+
+        // 邊界外的像素取最近的邊緣像素
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                for (int c = 0; c < channels; c++) {
+                    int sum = 0;
+                    for (int ky = -radius; ky <= radius; ky++) {
+                        const int sy = std::clamp(y + ky, 0, height - 1);
+                        for (int kx = -radius; kx <= radius; kx++) {
+                            const int sx = std::clamp(x + kx, 0, width - 1);
+                            sum += src[(static_cast<size_t>(sy) * width + sx) * channels + c];
+                        }
+                    }
+                    dst[(static_cast<size_t>(y) * width + x) * channels + c] = static_cast<uint8_t>(sum / count);
+                }
+            }
+        }
+        return result;
+    }
+
+    // 每個像素依 radiusMap 的灰階決定半徑，直接加總視窗內的像素
+    Image variableBlur(const Image& img, const Image& radiusMap, int maxRadius) {
+        maxRadius = std::min(maxRadius, kMaxVariableBlurRadius);
+        if (maxRadius <= 0) return img;
+
+        const int width = img.getWidth();
+        const int height = img.getHeight();
+        const int channels = img.getChannels();
+        const int mapChannels = radiusMap.getChannels();
+        Image result(width, height, channels);
+        const uint8_t* src = img.pixels();
+        const uint8_t* map = radiusMap.pixels();
+        uint8_t* dst = result.mutablePixels();
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const uint8_t* m = map + (static_cast<size_t>(y) * width + x) * mapChannels;
+                const int gray = mapChannels >= 3 ? (m[0] * 9798 + m[1] * 19235 + m[2] * 3735) >> 15 : m[0];
+                const int radius = static_cast<int>(std::lround(gray * maxRadius / 255.0));
+                const uint64_t count = static_cast<uint64_t>(2 * radius + 1) * (2 * radius + 1);
+                for (int c = 0; c < channels; c++) {
+                    uint64_t sum = 0;
+                    for (int ky = -radius; ky <= radius; ky++) {
+                        const int sy = std::clamp(y + ky, 0, height - 1);
+                        for (int kx = -radius; kx <= radius; kx++) {
+                            const int sx = std::clamp(x + kx, 0, width - 1);
+                            sum += src[(static_cast<size_t>(sy) * width + sx) * channels + c];
+                        }
+                    }
+                    dst[(static_cast<size_t>(y) * width + x) * channels + c] = static_cast<uint8_t>(sum / count);
+                }
+            }
+        }
+        return result;
+    }
+
+    // 視窗內的樣本排序後取中間的一個
+    Image median(const Image& img, int radius) {
+        radius = std::min(radius, kMaxMedianRadius);
+        if (radius <= 0) return img;
+
+        const int width = img.getWidth();
+        const int height = img.getHeight();
+        const int channels = img.getChannels();
+        Image result(width, height, channels);
+        const uint8_t* src = img.pixels();
+        uint8_t* dst = result.mutablePixels();
+        std::vector<uint8_t> window;
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                for (int c = 0; c < channels; c++) {
+                    window.clear();
+                    for (int ky = -radius; ky <= radius; ky++) {
+                        const int sy = std::clamp(y + ky, 0, height - 1);
+                        for (int kx = -radius; kx <= radius; kx++) {
+                            const int sx = std::clamp(x + kx, 0, width - 1);
+                            window.push_back(src[(static_cast<size_t>(sy) * width + sx) * channels + c]);
+                        }
+                    }
+                    std::sort(window.begin(), window.end());
+                    dst[(static_cast<size_t>(y) * width + x) * channels + c] = window[window.size() / 2];
+                }
+            }
+        }
+        return result;
+    }
+
+    Image invertColors(const Image& img) {
+        return mapBytes(img, [](uint8_t v) { return static_cast<uint8_t>(255 - v); });
+    }
+
+    Image brightness(const Image& img, int brightness) {
+        return mapBytes(img, [&](uint8_t v) { return clampByte(v + brightness); });
+    }
+
+    Image contrast(const Image& img, float contrast) {
+        return mapBytes(img, [&](uint8_t v) { return clampByte(static_cast<int>(128 + (v - 128) * contrast)); });
+    }
+
+    Image saturation(const Image& img, float saturation) {
+        if (img.getChannels() < 3) return img;
+
+        const int channels = img.getChannels();
+        Image result(img.getWidth(), img.getHeight(), channels);
+        const uint8_t* src = img.pixels();
+        uint8_t* dst = result.mutablePixels();
+        const size_t pixels = static_cast<size_t>(img.getWidth()) * img.getHeight();
+        for (size_t i = 0; i < pixels; i++) {
+            const uint8_t* p = src + i * channels;
+            uint8_t* q = dst + i * channels;
+            const float r = p[0] / 255.0f;
+            const float g = p[1] / 255.0f;
+            const float b = p[2] / 255.0f;
+            const float gray = 0.299f * r + 0.587f * g + 0.114f * b;
+            q[0] = static_cast<uint8_t>(std::clamp(gray + (r - gray) * saturation, 0.0f, 1.0f) * 255);
+            q[1] = static_cast<uint8_t>(std::clamp(gray + (g - gray) * saturation, 0.0f, 1.0f) * 255);
+            q[2] = static_cast<uint8_t>(std::clamp(gray + (b - gray) * saturation, 0.0f, 1.0f) * 255);
+            if (channels == 4) q[3] = p[3];
+        }
+        return result;
+    }
+
+    Image colorTemperature(const Image& img, int temperature) {
+        if (img.getChannels() < 3) return img;
+
+        const int channels = img.getChannels();
+        Image result(img.getWidth(), img.getHeight(), channels);
+        const uint8_t* src = img.pixels();
+        uint8_t* dst = result.mutablePixels();
+        const size_t pixels = static_cast<size_t>(img.getWidth()) * img.getHeight();
+        for (size_t i = 0; i < pixels; i++) {
+            const uint8_t* p = src + i * channels;
+            uint8_t* q = dst + i * channels;
+            q[0] = clampByte(p[0] + temperature);
+            q[1] = p[1];
+            q[2] = clampByte(p[2] - temperature);
+            if (channels == 4) q[3] = p[3];
+        }
+        return result;
+    }
+
+    // 9:1 網格變形：遮罩亮的地方變形較小，每個網格內以雙線性內插頂點位置、最近鄰取樣
+    Image projection(const Image& panorama, const Image& mask) {
+        const int width = panorama.getWidth();
+        const int height = panorama.getHeight();
+        const int channels = panorama.getChannels();
+        if (mask.getWidth() != width || mask.getHeight() != height) {
+            throw std::runtime_error("Mask size does not match panorama size");
+        }
+
+        const int newHeight = height;
+        const int newWidth = static_cast<int>(newHeight * 9.0f);
+        const int gridRows = 100;
+        const int gridCols = 100;
+        const int gridWidth = newWidth / gridCols;
+        const int gridHeight = newHeight / gridRows;
+        const float cx = width / 2.0f;
+        const float cy = height / 2.0f;
+        const uint8_t* maskData = mask.pixels();
+
+        // 頂點的重要性：遮罩灰度 > 128 為 1.2，再做一次內部五點平均 (逐列就地更新)
+        std::vector<float> importance((gridRows + 1) * (gridCols + 1), 1.0f);
+        auto at = [&](int row, int col) -> float& { return importance[row * (gridCols + 1) + col]; };
+        for (int row = 0; row <= gridRows; row++) {
+            for (int col = 0; col <= gridCols; col++) {
+                const int maskX = static_cast<int>((col * gridWidth) * (static_cast<float>(width) / newWidth));
+                const int maskY = static_cast<int>((row * gridHeight) * (static_cast<float>(height) / newHeight));
+                if (maskX < 0 || maskY < 0 || maskX >= width || maskY >= height) continue;
+                const uint8_t* m = maskData + (static_cast<size_t>(maskY) * width + maskX) * mask.getChannels();
+                float gray = m[0];
+                if (mask.getChannels() >= 3) gray = 0.2989f * m[0] + 0.5870f * m[1] + 0.1140f * m[2];
+                if (gray > 128) at(row, col) = 1.2f;
+            }
+        }
+        for (int row = 1; row < gridRows; row++) {
+            for (int col = 1; col < gridCols; col++) {
+                at(row, col) = (at(row - 1, col) + at(row + 1, col) + at(row, col - 1) + at(row, col + 1) + at(row, col)) / 5.0f;
+            }
+        }
+
+        // 頂點變形後的來源座標
+        std::vector<std::pair<float, float>> vertices((gridRows + 1) * (gridCols + 1));
+        for (int row = 0; row <= gridRows; row++) {
+            for (int col = 0; col <= gridCols; col++) {
+                const float x = static_cast<float>(col * gridWidth) * (static_cast<float>(width) / newWidth);
+                const float y = static_cast<float>(row * gridHeight);
+                const float dx = (x - cx) / width;
+                const float dy = (y - cy) / height;
+                const float r = std::clamp(std::sqrt(dx * dx + dy * dy), 0.01f, 0.5f);
+                const float scale = std::log(1.0f + r) / (r + 0.01f) * at(row, col);
+                vertices[row * (gridCols + 1) + col] = {
+                    std::clamp(cx + scale * dx * width, 0.0f, static_cast<float>(width - 1)),
+                    std::clamp(cy + scale * dy * height, 0.0f, static_cast<float>(height - 1)),
+                };
+            }
+        }
+
+        Image result(newWidth, newHeight, channels);
+        uint8_t* dst = result.mutablePixels();
+        const uint8_t* src = panorama.pixels();
+        for (int row = 0; row < gridRows; row++) {
+            for (int col = 0; col < gridCols; col++) {
+                const auto topLeft = vertices[row * (gridCols + 1) + col];
+                const auto topRight = vertices[row * (gridCols + 1) + col + 1];
+                const auto bottomLeft = vertices[(row + 1) * (gridCols + 1) + col];
+                const auto bottomRight = vertices[(row + 1) * (gridCols + 1) + col + 1];
+                for (int y = row * gridHeight; y < (row + 1) * gridHeight; y++) {
+                    for (int x = col * gridWidth; x < (col + 1) * gridWidth; x++) {
+                        const float ax = (x - col * gridWidth) / static_cast<float>(gridWidth);
+                        const float ay = (y - row * gridHeight) / static_cast<float>(gridHeight);
+                        const float wx = topLeft.first * (1 - ax) * (1 - ay) + topRight.first * ax * (1 - ay) +
+                            bottomLeft.first * (1 - ax) * ay + bottomRight.first * ax * ay;
+                        const float wy = topLeft.second * (1 - ax) * (1 - ay) + topRight.second * ax * (1 - ay) +
+                            bottomLeft.second * (1 - ax) * ay + bottomRight.second * ax * ay;
+                        const int sx = static_cast<int>(std::clamp(wx, 0.0f, static_cast<float>(width - 1)));
+                        const int sy = static_cast<int>(std::clamp(wy, 0.0f, static_cast<float>(height - 1)));
+                        for (int c = 0; c < channels; c++) {
+                            dst[(static_cast<size_t>(y) * newWidth + x) * channels + c] = src[(static_cast<size_t>(sy) * width + sx) * channels + c];
+                        }
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    Image processImage(const Image& img, int brightnessValue, float contrastValue, float saturationValue, int temperature) {
+        return colorTemperature(saturation(contrast(brightness(img, brightnessValue), contrastValue), saturationValue), temperature);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef REFERENCE_FILTERS_H
+#define REFERENCE_FILTERS_H
+
+#include "Image.h"
+#include "ImageProcessing.h"
+
+// ImageProcessing.h 各濾鏡的參考實作：單執行緒、逐像素的純量迴圈，不做 SIMD、查表融合或分塊
+// 只用來驗證最佳化後的版本 (benchmark --verify)；灰階使用最佳化前的雙精度公式，
+// 定點數版本可能差 1，由 --verify 的容許誤差處理
+namespace reference {
+    Image grayscale(const Image& img, GrayscaleMode mode);
+    Image blur(const Image& img, int radius);
+    Image variableBlur(const Image& img, const Image& radiusMap, int maxRadius);
+    Image median(const Image& img, int radius);
+    Image invertColors(const Image& img);
+    Image brightness(const Image& img, int brightness);
+    Image contrast(const Image& img, float contrast);
+    Image saturation(const Image& img, float saturation);
+    Image colorTemperature(const Image& img, int temperature);
+    Image projection(const Image& panorama, const Image& mask);
+
+    // 亮度、對比、飽和度、色溫依序各做一次 (每一步都截斷到 0-255)
+    Image processImage(const Image& img, int brightness, float contrast, float saturation, int temperature);
+}
+
+#endif // REFERENCE_FILTERS_H
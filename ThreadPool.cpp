@@ -0,0 +1,220 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <exception>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    // 目前執行緒所屬的執行緒池與工作執行緒編號 (非工作執行緒為 -1)
+    thread_local ThreadPool* currentPool = nullptr;
+    thread_local int currentWorker = -1;
+
+    void pinToCpu(std::thread& thread, int cpu) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)cpu;
+#endif
+    }
+}
+
+ThreadPool::ThreadPool(int threadCount, bool pinThreads) {
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    if (threadCount <= 0) {
+        threadCount = std::max(1, hardwareThreads - 1);
+    }
+
+    for (int i = 0; i < threadCount; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < threadCount; i++) {
+        threads.emplace_back([this, i] { workerLoop(i); });
+        if (pinThreads) {
+            pinToCpu(threads.back(), i % hardwareThreads);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    if (currentPool == this) {
+        Worker& worker = *workers[currentWorker];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    else {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        injected.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pending++;
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::popTask(int index, std::function<void()>& task) {
+    // 1. 自己的佇列 (LIFO，資料仍在快取中)
+    if (index >= 0) {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            pending--;
+            return true;
+        }
+    }
+
+    // 2. 共享佇列 (FIFO，依提交順序公平分配)
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        if (!injected.empty()) {
+            task = std::move(injected.front());
+            injected.pop_front();
+            pending--;
+            return true;
+        }
+    }
+
+    // 3. 從其他工作執行緒竊取最舊的任務
+    const int count = static_cast<int>(workers.size());
+    for (int k = 1; k <= count; k++) {
+        const int victim = (std::max(index, 0) + k) % count;
+        if (victim == index) continue;
+        Worker& worker = *workers[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask() {
+    if (pending.load() == 0) return false;
+
+    std::function<void()> task;
+    if (!popTask(currentPool == this ? currentWorker : -1, task)) return false;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(int index) {
+    currentPool = this;
+    currentWorker = index;
+    trace::setThreadName("worker " + std::to_string(index));
+
+    std::function<void()> task;
+    while (true) {
+        if (popTask(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || pending.load() > 0; });
+        if (stopping && pending.load() == 0) return;
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+int ExecutionContext::concurrency() const {
+    const int available = getPool().getThreadCount() + 1;
+    return maxThreads > 0 ? std::min(maxThreads, available) : available;
+}
+
+const ExecutionContext& ExecutionContext::defaultContext() {
+    static const ExecutionContext ctx;
+    return ctx;
+}
+
+void parallelFor(const ExecutionContext& ctx, int begin, int end, const std::function<void(int, int)>& fn) {
+    const int total = end - begin;
+    if (total <= 0) return;
+
+    const int threads = ctx.concurrency();
+    const int grain = ctx.grainSize > 0 ? ctx.grainSize : std::max(1, total / (threads * 4));
+    const int chunks = (total + grain - 1) / grain;
+    if (threads <= 1 || chunks <= 1) {
+        fn(begin, end);
+        return;
+    }
+
+    // 共享狀態由 shared_ptr 管理：晚開始的輔助任務發現沒有區塊可領時直接結束，不會再觸碰 fn
+    struct State {
+        std::atomic<int> next{ 0 };
+        std::atomic<int> completed{ 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    const std::function<void(int, int)>* body = &fn;
+    const char* stage = trace::currentScope();
+
+    auto runChunks = [state, body, stage, begin, end, grain, chunks] {
+        int chunk;
+        while ((chunk = state->next.fetch_add(1)) < chunks) {
+            const int chunkBegin = begin + chunk * grain;
+            const int chunkEnd = std::min(end, chunkBegin + grain);
+            try {
+                // 工作執行緒上的區塊以呼叫端的區段命名，計時與計數器都歸到同一個區段
+                TRACE_SCOPE(stage ? stage : "parallelFor chunk");
+                (*body)(chunkBegin, chunkEnd);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) state->error = std::current_exception();
+            }
+            if (state->completed.fetch_add(1) + 1 == chunks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    ThreadPool& pool = ctx.getPool();
+    const int helpers = std::min(threads - 1, chunks - 1);
+    for (int i = 0; i < helpers; i++) {
+        pool.submit(runChunks);
+    }
+    runChunks();
+
+    // 等待其他執行緒完成已領取的區塊，期間協助執行池中的其他任務
+    while (state->completed.load() < chunks) {
+        if (pool.runPendingTask()) continue;
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&] { return state->completed.load() >= chunks; });
+    }
+
+    if (state->error) std::rethrow_exception(state->error);
+}
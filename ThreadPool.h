@@ -0,0 +1,72 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 常駐的 work-stealing 執行緒池
+// 每個工作執行緒擁有自己的任務佇列，閒置時從共享佇列或其他執行緒的佇列竊取任務
+class ThreadPool {
+public:
+    // threadCount <= 0 時使用硬體執行緒數 - 1 (呼叫端本身也會參與計算)
+    explicit ThreadPool(int threadCount = 0, bool pinThreads = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getThreadCount() const { return static_cast<int>(threads.size()); }
+
+    // 提交任務：工作執行緒提交的任務放入自己的佇列 (巢狀平行)，其他執行緒放入共享佇列
+    void submit(std::function<void()> task);
+
+    // 在目前執行緒執行一個待處理的任務，等待時用來協助計算；沒有任務時回傳 false
+    bool runPendingTask();
+
+    // 全域預設執行緒池
+    static ThreadPool& global();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(int index);
+    bool popTask(int index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex injectMutex;
+    std::deque<std::function<void()>> injected; // 非工作執行緒提交的任務 (FIFO，多條管線輪流取用)
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> pending{ 0 };
+    bool stopping = false;
+};
+
+// 濾鏡的執行設定
+struct ExecutionContext {
+    ThreadPool* pool = nullptr; // nullptr 表示使用全域執行緒池
+    int maxThreads = 0;         // 單次呼叫最多使用的執行緒數，含呼叫端 (0: 執行緒池大小 + 1)
+    int grainSize = 0;          // 每個任務至少處理的項目數 (列數) (0: 自動)
+
+    ThreadPool& getPool() const { return pool ? *pool : ThreadPool::global(); }
+    int concurrency() const;
+
+    static const ExecutionContext& defaultContext();
+};
+
+// 將 [begin, end) 切成區塊平行執行 fn(blockBegin, blockEnd)，呼叫端也參與執行
+// 區塊劃分只取決於範圍與 grainSize，每個項目恰好被處理一次
+void parallelFor(const ExecutionContext& ctx, int begin, int end, const std::function<void(int, int)>& fn);
+
+#endif // THREAD_POOL_H
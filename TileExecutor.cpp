@@ -0,0 +1,165 @@
+#include "TileExecutor.h"
+#include "MemoryStats.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+    struct Rect {
+        int x0, y0, x1, y1;
+    };
+
+    PixelRegion subRegion(const PixelRegion& region, const Rect& rect) {
+        return { region.pixel(rect.x0, rect.y0), region.stride, rect.x0, rect.y0,
+                 rect.x1 - rect.x0, rect.y1 - rect.y0, region.channels };
+    }
+
+    size_t l2CacheBytes() {
+#if defined(__linux__) && defined(_SC_LEVEL2_CACHE_SIZE)
+        long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (size > 0) return static_cast<size_t>(size);
+#endif
+        return 1 << 20; // 無法查詢時假設 1 MB
+    }
+
+    // 點運算階段：逐列呼叫單列核心 kernel(src, dst, pixels, channels)
+    template <typename RowKernel>
+    TileStage pointStage(RowKernel kernel) {
+        TileStage stage;
+        stage.halo = 0;
+        stage.run = [kernel](const PixelRegion& src, const PixelRegion& dst, int, int) {
+            for (int y = dst.y; y < dst.y + dst.height; y++) {
+                kernel(src.pixel(dst.x, y), dst.row(y), dst.width, dst.channels);
+            }
+        };
+        return stage;
+    }
+}
+
+// 映射的影像只能當來源；輸出影像都是新建立的，像素由自己持有
+PixelRegion imageRegion(const Image& img) {
+    return { const_cast<uint8_t*>(img.pixels()), static_cast<size_t>(img.getWidth()) * img.getChannels(),
+             0, 0, img.getWidth(), img.getHeight(), img.getChannels() };
+}
+
+int defaultTileSize(int channels, int totalHalo) {
+    // 來源、兩個中間暫存區與輸出區塊同時留在 L2
+    const double side = std::sqrt(static_cast<double>(l2CacheBytes()) / (4.0 * channels));
+    int tile = static_cast<int>(side) - 2 * totalHalo;
+    tile = std::max(tile, std::max(32, 2 * totalHalo));
+    return std::max(16, tile / 16 * 16);
+}
+
+Image runTiled(const Image& img, const std::vector<TileStage>& stages, const ExecutionContext& ctx, int tileSize) {
+    TRACE_SCOPE("runTiled");
+    if (stages.empty()) return img;
+
+    const int width = img.getWidth();
+    const int height = img.getHeight();
+    const int stageCount = static_cast<int>(stages.size());
+
+    // haloAfter[k]：第 k 個階段 (含) 之後所有階段的 halo 總和，即第 k 個階段輸入需要的擴展量
+    std::vector<int> haloAfter(stageCount + 1, 0);
+    for (int k = stageCount - 1; k >= 0; k--) {
+        haloAfter[k] = haloAfter[k + 1] + stages[k].halo;
+    }
+    if (tileSize <= 0) {
+        tileSize = defaultTileSize(img.getChannels(), haloAfter[0]);
+    }
+
+    Image result(width, height, img.getChannels());
+    const PixelRegion src = imageRegion(img);
+    const PixelRegion dst = imageRegion(result);
+
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+
+    // 中間結果最大的是第 0 個階段的輸出 (tile 向外擴展 haloAfter[1])
+    const int scratchSide = stageCount > 1 ? tileSize + 2 * haloAfter[1] : 0;
+    const size_t scratchBytes = static_cast<size_t>(std::min(width, scratchSide)) *
+                                std::min(height, scratchSide) * img.getChannels();
+
+    parallelFor(ctx, 0, tilesX * tilesY, [&](int tileBegin, int tileEnd) {
+        // 每個區塊配置自己的兩個中間暫存區 (ping-pong)，區塊內的 tile 重複使用，區塊結束即釋放
+        // 不用 thread_local：等待巢狀 parallelFor 時同一執行緒可能插入執行另一個 tile 任務
+        std::vector<uint8_t> scratch[2] = { std::vector<uint8_t>(scratchBytes), std::vector<uint8_t>(scratchBytes) };
+        const memstats::Allocation scratchAllocation(2 * scratchBytes, "tile scratch");
+
+        for (int t = tileBegin; t < tileEnd; t++) {
+            const Rect tile = { (t % tilesX) * tileSize, (t / tilesX) * tileSize,
+                                std::min(width, (t % tilesX + 1) * tileSize),
+                                std::min(height, (t / tilesX + 1) * tileSize) };
+            auto expand = [&](int halo) {
+                return Rect{ std::max(0, tile.x0 - halo), std::max(0, tile.y0 - halo),
+                             std::min(width, tile.x1 + halo), std::min(height, tile.y1 + halo) };
+            };
+
+            PixelRegion in = subRegion(src, expand(haloAfter[0]));
+            for (int k = 0; k < stageCount; k++) {
+                PixelRegion out;
+                if (k == stageCount - 1) {
+                    out = subRegion(dst, tile);
+                }
+                else {
+                    const Rect rect = expand(haloAfter[k + 1]);
+                    const size_t stride = static_cast<size_t>(rect.x1 - rect.x0) * img.getChannels();
+                    out = { scratch[k % 2].data(), stride, rect.x0, rect.y0,
+                            rect.x1 - rect.x0, rect.y1 - rect.y0, img.getChannels() };
+                }
+                stages[k].run(in, out, width, height);
+                in = out;
+            }
+        }
+    });
+    return result;
+}
+
+TileStage blurStage(int radius) {
+    radius = std::max(radius, 0);
+    TileStage stage;
+    stage.halo = radius;
+    stage.run = [radius](const PixelRegion& src, const PixelRegion& dst, int imageWidth, int imageHeight) {
+        if (radius == 0) {
+            for (int y = dst.y; y < dst.y + dst.height; y++) {
+                std::copy(src.pixel(dst.x, y), src.pixel(dst.x, y) + static_cast<size_t>(dst.width) * dst.channels, dst.row(y));
+            }
+            return;
+        }
+        blurRegion(src, dst, radius, imageWidth, imageHeight);
+    };
+    return stage;
+}
+
+TileStage invertStage() {
+    return pointStage([](const uint8_t* src, uint8_t* dst, int pixels, int channels) {
+        invertRow(src, dst, static_cast<size_t>(pixels) * channels);
+    });
+}
+
+TileStage brightnessStage(int brightness) {
+    return pointStage([brightness](const uint8_t* src, uint8_t* dst, int pixels, int channels) {
+        brightnessRow(src, dst, static_cast<size_t>(pixels) * channels, brightness);
+    });
+}
+
+TileStage contrastStage(float contrast) {
+    return pointStage([contrast](const uint8_t* src, uint8_t* dst, int pixels, int channels) {
+        contrastRow(src, dst, static_cast<size_t>(pixels) * channels, contrast);
+    });
+}
+
+TileStage saturationStage(float saturation) {
+    return pointStage([saturation](const uint8_t* src, uint8_t* dst, int pixels, int channels) {
+        saturationRow(src, dst, pixels, channels, saturation);
+    });
+}
+
+TileStage colorTemperatureStage(int temperature) {
+    return pointStage([temperature](const uint8_t* src, uint8_t* dst, int pixels, int channels) {
+        colorTemperatureRow(src, dst, pixels, channels, temperature);
+    });
+}
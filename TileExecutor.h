@@ -0,0 +1,38 @@
+#ifndef TILE_EXECUTOR_H
+#define TILE_EXECUTOR_H
+
+#include "Image.h"
+#include "FilterKernels.h"
+#include "ThreadPool.h"
+#include <functional>
+#include <vector>
+
+// 分塊管線中的一個階段
+struct TileStage {
+    int halo = 0; // 計算一個輸出像素需要的鄰域半徑 (點運算為 0)
+
+    // 由 src 計算 dst 區域，src 涵蓋 dst 向外擴展 halo 後與影像範圍的交集
+    std::function<void(const PixelRegion& src, const PixelRegion& dst, int imageWidth, int imageHeight)> run;
+};
+
+// 逐塊執行整條管線：每個區塊在同一個任務中依序通過所有階段，中間結果只存在區塊大小的暫存區
+// 各階段的 halo 會自動累加，鄰域運算在區塊邊界的結果與整張影像處理完全相同
+// tileSize <= 0 時依 L2 快取大小決定
+Image runTiled(const Image& img, const std::vector<TileStage>& stages,
+               const ExecutionContext& ctx = ExecutionContext::defaultContext(), int tileSize = 0);
+
+// 整張影像的區域視圖
+PixelRegion imageRegion(const Image& img);
+
+// 依 L2 快取大小與總 halo 估算區塊邊長
+int defaultTileSize(int channels, int totalHalo);
+
+// 對應 ImageProcessing.h 中各濾鏡的階段
+TileStage blurStage(int radius);
+TileStage invertStage();
+TileStage brightnessStage(int brightness);
+TileStage contrastStage(float contrast);
+TileStage saturationStage(float saturation);
+TileStage colorTemperatureStage(int temperature);
+
+#endif // TILE_EXECUTOR_H
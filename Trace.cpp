@@ -0,0 +1,175 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+    std::atomic<bool> active{ false };
+}
+
+namespace {
+    struct Event {
+        const char* name;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    // 一個執行緒的事件；只有擁有者寫入，鎖只在匯出或清除時才會有競爭
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Event> events; // 第一次記錄時才配置
+        size_t capacity = 0;
+        uint64_t written = 0;      // 累計寫入數，取餘數即下一個位置
+        uint32_t id = 0;
+        std::string name;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        // 執行緒結束後仍保留，匯出時才看得到短命執行緒的事件
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        uint32_t nextId = 1;
+        size_t capacity = 1 << 16;
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    ThreadBuffer& currentBuffer() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>();
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            buffer->id = reg.nextId++;
+            buffer->capacity = reg.capacity;
+            reg.buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    thread_local trace::Scope* innermost = nullptr;
+
+    void writeEscaped(std::ostream& out, const std::string& text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+            else out << c;
+        }
+        out << '"';
+    }
+}
+
+namespace trace {
+    void setEnabled(bool on) {
+        nowNs(); // 固定時間原點
+        active.store(on, std::memory_order_relaxed);
+    }
+
+    void setBufferCapacity(size_t events) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.capacity = std::max<size_t>(events, 1);
+    }
+
+    void setThreadName(const std::string& name) {
+        ThreadBuffer& buffer = currentBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    void clear() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& buffer : reg.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->written = 0;
+        }
+    }
+
+    uint64_t nowNs() {
+        using Clock = std::chrono::steady_clock;
+        static const Clock::time_point epoch = Clock::now();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count());
+    }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs) {
+        ThreadBuffer& buffer = currentBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.empty()) {
+            buffer.events.resize(buffer.capacity);
+        }
+        buffer.events[buffer.written % buffer.events.size()] = { name, startNs, endNs - startNs };
+        buffer.written++;
+    }
+
+    const char* currentScope() {
+        return innermost ? innermost->name : nullptr;
+    }
+
+    void Scope::begin(const char* scopeName) {
+        name = scopeName;
+        parent = innermost;
+        innermost = this;
+        counted = perfcounters::enabled();
+        if (counted) perfcounters::enter(name);
+        timed = enabled();
+        if (timed) start = nowNs();
+    }
+
+    void Scope::end() {
+        const uint64_t finish = timed ? nowNs() : 0;
+        if (counted) perfcounters::leave();
+        if (timed) record(name, start, finish);
+        innermost = parent;
+    }
+
+    void writeChromeTrace(std::ostream& out) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        auto separator = [&]() -> std::ostream& {
+            if (!first) out << ",\n";
+            first = false;
+            return out;
+        };
+
+        out << std::fixed << std::setprecision(3);
+        for (auto& buffer : reg.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            if (!buffer->name.empty()) {
+                separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+                writeEscaped(out, buffer->name);
+                out << "}}";
+            }
+
+            // 環狀緩衝區由最舊的事件開始輸出
+            const size_t size = buffer->events.size();
+            const uint64_t count = std::min<uint64_t>(buffer->written, size);
+            for (uint64_t i = buffer->written - count; i < buffer->written; i++) {
+                const Event& event = buffer->events[i % size];
+                separator() << "{\"name\":";
+                writeEscaped(out, event.name);
+                out << ",\"cat\":\"paranoma\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                    << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+            }
+        }
+        out << "]}\n";
+    }
+
+    bool saveChromeTrace(const std::string& filename) {
+        std::ofstream out(filename);
+        if (!out) return false;
+        writeChromeTrace(out);
+        return static_cast<bool>(out);
+    }
+}
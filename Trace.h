@@ -0,0 +1,80 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "MemoryStats.h"
+#include "PerfCounters.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// 區段計時：每個執行緒把 (名稱, 開始, 長度) 寫進自己的環狀緩衝區，滿了覆蓋最舊的事件
+// 停用時每個區段只多三次 relaxed 讀取；以 -DTRACE_DISABLED 編譯則完全移除
+// 同一個區段也是 perfcounters 累計硬體計數器、memstats 歸類配置的單位
+// 匯出為 Chrome trace-event JSON，可用 chrome://tracing 或 Perfetto 開啟
+namespace trace {
+    extern std::atomic<bool> active;
+
+    inline bool enabled() { return active.load(std::memory_order_relaxed); }
+    void setEnabled(bool on);
+
+    // 每個執行緒保留的最新事件數 (只影響之後才開始記錄的執行緒)
+    void setBufferCapacity(size_t events);
+
+    // 目前執行緒在追蹤檔中顯示的名稱
+    void setThreadName(const std::string& name);
+
+    // 丟棄所有執行緒已記錄的事件
+    void clear();
+
+    // 匯出所有執行緒的事件 (記錄中也可以呼叫)
+    void writeChromeTrace(std::ostream& out);
+    // 寫入失敗回傳 false
+    bool saveChromeTrace(const std::string& filename);
+
+    // 自第一次呼叫起經過的奈秒數 (steady_clock)
+    uint64_t nowNs();
+    void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    // 目前執行緒最內層的區段名稱 (沒有記錄中的區段時為 nullptr)
+    // parallelFor 用來把工作執行緒上的區塊歸到呼叫端的區段
+    const char* currentScope();
+
+    // name 只保存指標，必須是字串常值或存活到匯出之後
+    class Scope {
+    public:
+        explicit Scope(const char* name) {
+            if (enabled() || perfcounters::enabled() || memstats::enabled()) begin(name);
+        }
+        ~Scope() {
+            if (name) end();
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        friend const char* currentScope();
+
+        void begin(const char* scopeName);
+        void end();
+
+        const char* name = nullptr;
+        Scope* parent = nullptr;
+        uint64_t start = 0;
+        bool timed = false;
+        bool counted = false;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef TRACE_DISABLED
+#define TRACE_SCOPE(name) ((void)0)
+#else
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,76 @@
+#include "YCbCrImage.h"
+#include "JpegIO.h"
+#include "Trace.h"
+#include "stb_image.h"
+#include "stb_image_write.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+// 構造函數
+YCbCrImage::YCbCrImage(int w, int h, int chromaShiftX, int chromaShiftY, bool grayscale)
+    : width(w), height(h), chromaShiftX(chromaShiftX), chromaShiftY(chromaShiftY) {
+    if (w <= 0 || h <= 0 || chromaShiftX < 0 || chromaShiftX > 1 || chromaShiftY < 0 || chromaShiftY > 1) {
+        throw std::invalid_argument("Invalid image dimensions or chroma subsampling.");
+    }
+    for (int i = 0; i < (grayscale ? 1 : 3); i++) {
+        planes[i].assign(static_cast<size_t>(planeWidth(i)) * planeHeight(i), i == 0 ? 0 : 128);
+    }
+    allocation = memstats::Allocation(byteSize());
+}
+
+// 從 JPEG 文件加載平面 (解碼後不做升取樣與色彩轉換)
+YCbCrImage YCbCrImage::loadFromJPG(const std::string& filename, const ExecutionContext& ctx) {
+    std::vector<uint8_t> bytes;
+    if (!jpegio::readFile(filename, bytes)) {
+        throw std::runtime_error("Failed to load image: " + filename);
+    }
+    try {
+        return decode(bytes.data(), bytes.size(), ctx);
+    }
+    catch (const std::runtime_error& e) {
+        throw std::runtime_error(std::string(e.what()) + ": " + filename);
+    }
+}
+
+YCbCrImage YCbCrImage::decode(const uint8_t* bytes, size_t size, const ExecutionContext& ctx) {
+    TRACE_SCOPE("YCbCrImage::decode");
+    if (size > INT_MAX) {
+        throw std::invalid_argument("Encoded image is too large.");
+    }
+    stbi_jpeg_planes decoded;
+    const bool parallel = ctx.concurrency() > 1;
+    if (!stbi_load_jpeg_planes_from_memory(bytes, static_cast<int>(size), &decoded,
+                                           parallel ? jpegio::runParallel : nullptr, const_cast<ExecutionContext*>(&ctx))) {
+        throw std::runtime_error(std::string("Failed to decode image planes (") + stbi_failure_reason() + ")");
+    }
+
+    const bool grayscale = decoded.cb == nullptr;
+    YCbCrImage result(decoded.w, decoded.h, decoded.chroma_shift_x, decoded.chroma_shift_y, grayscale);
+    const uint8_t* sources[3] = { decoded.y, decoded.cb, decoded.cr };
+    for (int i = 0; i < result.planeCount(); i++) {
+        std::copy(sources[i], sources[i] + result.planes[i].size(), result.planes[i].begin());
+    }
+    stbi_jpeg_planes_free(&decoded);
+    return result;
+}
+
+// 保存為 JPEG
+void YCbCrImage::saveAsJPG(const std::string& filename, int quality, const ExecutionContext& ctx) const {
+    TRACE_SCOPE("YCbCrImage::saveAsJPG");
+    stbi_write_jpg_planes source = {};
+    source.y = planes[0].data();
+    source.y_stride = width;
+    if (!isGrayscale()) {
+        source.cb = planes[1].data();
+        source.cr = planes[2].data();
+        source.chroma_stride = planeWidth(1);
+        source.chroma_shift_x = chromaShiftX;
+        source.chroma_shift_y = chromaShiftY;
+    }
+
+    jpegio::writeStriped(filename, width, height, quality, ctx, [&](int first, int last, std::vector<uint8_t>& out) {
+        return stbi_write_jpg_planes_mcu_rows_to_func(jpegio::appendToBuffer, &out, width, height,
+                                                      &source, quality, first, last) != 0;
+    });
+}
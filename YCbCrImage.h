@@ -0,0 +1,55 @@
+#ifndef YCBCR_IMAGE_H
+#define YCBCR_IMAGE_H
+
+#include <vector>
+#include <cstdint>
+#include <string>
+#include "ThreadPool.h"
+#include "MemoryStats.h"
+
+// 以 JPEG 原生取樣率保存的 Y / Cb / Cr 平面，JPEG 進 JPEG 出時省去色度升取樣與兩次色彩轉換
+// 色度平面在 chromaShift 為 1 的方向上解析度減半 (無條件進位)；灰階影像沒有色度平面
+class YCbCrImage {
+private:
+    int width;          // 影像寬度 (亮度平面尺寸)
+    int height;         // 影像高度
+    int chromaShiftX;   // 色度水平縮小位移 (0 或 1)
+    int chromaShiftY;   // 色度垂直縮小位移 (0 或 1)
+    std::vector<uint8_t> planes[3]; // Y、Cb、Cr，每列緊密排列
+    memstats::Allocation allocation; // 三個平面的記帳
+
+public:
+    // 構造函數 (色度初始值 128 即無色)
+    YCbCrImage(int w, int h, int chromaShiftX, int chromaShiftY, bool grayscale = false);
+
+    // 從 JPEG 文件加載平面，RGB / CMYK 編碼或不支援的取樣率會拋出例外 (改用 Image::loadFromJPG)
+    static YCbCrImage loadFromJPG(const std::string& filename,
+                                  const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+    // 從記憶體中的 JPEG 解碼平面，限制同上
+    static YCbCrImage decode(const uint8_t* bytes, size_t size,
+                             const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+    // 直接由平面編碼為 JPEG (色度依品質設定平均或複製到 4:2:0 / 4:4:4)
+    void saveAsJPG(const std::string& filename, int quality = 90,
+                   const ExecutionContext& ctx = ExecutionContext::defaultContext()) const;
+
+    // 基本信息
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getChromaShiftX() const { return chromaShiftX; }
+    int getChromaShiftY() const { return chromaShiftY; }
+    bool isGrayscale() const { return planes[1].empty(); }
+    int planeCount() const { return isGrayscale() ? 1 : 3; }
+
+    // 平面 0 為 Y，1 為 Cb，2 為 Cr
+    int planeWidth(int index) const { return index == 0 ? width : (width + (1 << chromaShiftX) - 1) >> chromaShiftX; }
+    int planeHeight(int index) const { return index == 0 ? height : (height + (1 << chromaShiftY) - 1) >> chromaShiftY; }
+    std::vector<uint8_t>& plane(int index) { return planes[index]; }
+    const std::vector<uint8_t>& plane(int index) const { return planes[index]; }
+
+    // 三個平面的總位元組數
+    size_t byteSize() const { return planes[0].size() + planes[1].size() + planes[2].size(); }
+};
+
+#endif // YCBCR_IMAGE_H
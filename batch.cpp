@@ -0,0 +1,525 @@
+// 無視窗批次處理工具：對目錄或檔案清單套用 processImage / applyProjection
+// 解碼、處理、編碼三個階段以有界佇列串接，不同影像的各階段可同時進行
+#include <iostream>
+#include "Image.h"
+#include "YCbCrImage.h"
+#include "ImageCache.h"
+#include "ImageProbe.h"
+#include "PrefetchReader.h"
+#include "ImageProcessing.h"
+#include "BoundedQueue.h"
+#include "MemoryBudget.h"
+#include "MemoryStats.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// 每張影像套用的處理
+struct Recipe {
+	int brightness = 0;
+	float contrast = 1.0f;
+	float saturation = 1.0f;
+	int temperature = 0;
+
+	bool projection = false; // 是否套用圓柱投影
+	std::string maskPath = "paranoma_mask.JPG";
+
+	int quality = 90;
+
+	// 預估單張影像在整個流程中的記憶體峰值 (位元組)
+	size_t predictPeakBytes(int width, int height, int channels) const {
+		const size_t source = static_cast<size_t>(width) * height * channels;
+
+		// 解碼：stb 的分量緩衝 + stb 輸出 + 複製到 Image
+		size_t peak = 3 * source;
+
+		// 投影：來源 + 9:1 輸出 + 網格
+		size_t current = source;
+		if (projection) {
+			const size_t projected = static_cast<size_t>(height * 9.0f) * height * channels;
+			const size_t grid = 101 * 101 * (sizeof(std::pair<float, float>) + sizeof(float));
+			peak = std::max(peak, source + projected + grid);
+			current = projected;
+		}
+
+		// 調整：輸入 + 輸出 (中間結果只存在分塊暫存區)
+		return std::max(peak, 2 * current);
+	}
+};
+
+struct BatchOptions {
+	Recipe recipe;
+	std::vector<std::string> inputs;
+	std::string outputDir = "output";
+	int decoders = 2;   // 解碼執行緒數
+	int processors = 2; // 同時處理的影像數 (每張影像內部使用執行緒池)
+	int encoders = 2;   // 編碼執行緒數
+	int queueDepth = 4; // 階段之間佇列長度
+	int prefetch = 8;   // 預先讀入記憶體的檔案數
+	int threads = 0;    // 濾鏡執行緒數上限 (0: 全部)
+	size_t memoryLimit = 0; // 進行中影像的記憶體上限 (位元組，0: 實體記憶體的一半)
+	bool ycbcr = false;     // 不投影時直接在 YCbCr 平面上調整，省去色度升取樣與兩次色彩轉換
+	std::string cacheDir;   // 非空時 RGB 解碼結果存成原始像素快取，重跑時直接映射
+	std::string tracePath;  // 非空時記錄各階段與濾鏡的計時，結束後寫成 Chrome trace JSON
+	bool memoryReport = false; // 逐張報告像素緩衝區的峰值與各區段的占比
+};
+
+struct Job {
+	size_t index = 0;
+	uint64_t pixels = 0; // 來源影像像素數
+	MemoryBudget::Reservation reservation; // 流程結束 (或失敗丟棄) 時歸還
+	std::optional<Image> image;
+	std::optional<YCbCrImage> planar; // --ycbcr 時使用，與 image 只會有一個
+	std::shared_ptr<memstats::Account> memory; // --memory-report 時記錄這張影像的配置
+};
+
+void printUsage() {
+	std::cerr <<
+		"Usage: batch [options] <file | directory | @list.txt>...\n"
+		"  -o, --output DIR        output directory (default: output)\n"
+		"                          (files are named <stem>.jpg; inputs sharing a stem are rejected)\n"
+		"  --brightness N          brightness offset (default: 0)\n"
+		"  --contrast F            contrast factor (default: 1.0)\n"
+		"  --saturation F          saturation factor (default: 1.0)\n"
+		"  --temperature N         colour temperature offset (default: 0)\n"
+		"  --projection R,SCALE    apply cylindrical projection before adjustments\n"
+		"                          (R and SCALE are accepted but currently unused)\n"
+		"  --mask FILE             projection mask (default: paranoma_mask.JPG)\n"
+		"  --quality Q             JPEG quality 1-100 (default: 90)\n"
+		"  --threads N             filter threads per image (default: all)\n"
+		"  --decoders N            decode threads (default: 2)\n"
+		"  --processors N          images processed concurrently (default: 2)\n"
+		"  --encoders N            encode threads (default: 2)\n"
+		"  --queue N               queue depth between stages (default: 4)\n"
+		"  --prefetch N            files read ahead of the decoders (default: 8)\n"
+		"  --memory MB             memory budget for images in flight (default: half of RAM)\n"
+		"  --ycbcr                 adjust JPEG luma/chroma planes directly, skipping the RGB\n"
+		"                          round trip (approximate; ignored with --projection)\n"
+		"  --cache DIR             keep decoded pixels in DIR so reruns map them instead of decoding\n"
+		"  --trace FILE            write a Chrome trace-event JSON of every stage and filter call\n"
+		"  --memory-report         report peak pixel-buffer memory per image and per stage\n";
+}
+
+bool isJpegPath(const fs::path& path) {
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return ext == ".jpg" || ext == ".jpeg";
+}
+
+// 展開目錄與 @清單檔
+std::vector<std::string> collectInputs(const std::vector<std::string>& args) {
+	std::vector<std::string> files;
+	for (const auto& arg : args) {
+		if (!arg.empty() && arg[0] == '@') {
+			std::ifstream list(arg.substr(1));
+			if (!list) throw std::runtime_error("Failed to open file list: " + arg.substr(1));
+			std::string line;
+			while (std::getline(list, line)) {
+				if (!line.empty() && line.back() == '\r') line.pop_back();
+				if (!line.empty()) files.push_back(line);
+			}
+		}
+		else if (fs::is_directory(arg)) {
+			std::vector<std::string> entries;
+			for (const auto& entry : fs::directory_iterator(arg)) {
+				if (entry.is_regular_file() && isJpegPath(entry.path())) {
+					entries.push_back(entry.path().string());
+				}
+			}
+			std::sort(entries.begin(), entries.end());
+			files.insert(files.end(), entries.begin(), entries.end());
+		}
+		else {
+			files.push_back(arg);
+		}
+	}
+	return files;
+}
+
+std::string outputPathFor(const BatchOptions& options, const std::string& input) {
+	return (fs::path(options.outputDir) / fs::path(input).stem()).string() + ".jpg";
+}
+
+// 輸出檔名只取主檔名，不同目錄的 x.jpg、x.jpg 與 x.jpeg 或重複列出的同一個檔案會寫到同一個輸出
+// 多個編碼執行緒同時寫入時結果會互相覆蓋，事先拒絕
+void checkOutputConflicts(const BatchOptions& options) {
+	std::unordered_map<std::string, std::string> owners;
+	for (const auto& input : options.inputs) {
+		const std::string output = outputPathFor(options, input);
+		auto inserted = owners.emplace(output, input);
+		if (!inserted.second) {
+			throw std::invalid_argument("Inputs " + inserted.first->second + " and " + input + " would both be written to " + output);
+		}
+	}
+}
+
+bool parseArguments(int argc, char** argv, BatchOptions& options) {
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+			return argv[++i];
+		};
+
+		if (arg == "-h" || arg == "--help") return false;
+		else if (arg == "-o" || arg == "--output") options.outputDir = value();
+		else if (arg == "--brightness") options.recipe.brightness = std::stoi(value());
+		else if (arg == "--contrast") options.recipe.contrast = std::stof(value());
+		else if (arg == "--saturation") options.recipe.saturation = std::stof(value());
+		else if (arg == "--temperature") options.recipe.temperature = std::stoi(value());
+		else if (arg == "--projection") {
+			// R,SCALE 仍然檢查格式以相容舊的命令列，但目前的投影實作不使用
+			std::string spec = value();
+			size_t comma = spec.find(',');
+			options.recipe.projection = true;
+			std::stod(spec.substr(0, comma));
+			if (comma != std::string::npos) std::stof(spec.substr(comma + 1));
+		}
+		else if (arg == "--mask") options.recipe.maskPath = value();
+		else if (arg == "--quality") options.recipe.quality = std::clamp(std::stoi(value()), 1, 100);
+		else if (arg == "--threads") options.threads = std::stoi(value());
+		else if (arg == "--decoders") options.decoders = std::max(1, std::stoi(value()));
+		else if (arg == "--processors") options.processors = std::max(1, std::stoi(value()));
+		else if (arg == "--encoders") options.encoders = std::max(1, std::stoi(value()));
+		else if (arg == "--queue") options.queueDepth = std::max(1, std::stoi(value()));
+		else if (arg == "--prefetch") options.prefetch = std::max(1, std::stoi(value()));
+		else if (arg == "--memory") options.memoryLimit = static_cast<size_t>(std::stoull(value())) << 20;
+		else if (arg == "--ycbcr") options.ycbcr = true;
+		else if (arg == "--cache") options.cacheDir = value();
+		else if (arg == "--trace") options.tracePath = value();
+		else if (arg == "--memory-report") options.memoryReport = true;
+		else if (arg.size() > 1 && arg[0] == '-') throw std::invalid_argument("Unknown option: " + arg);
+		else inputs.push_back(arg);
+	}
+
+	options.inputs = collectInputs(inputs);
+	checkOutputConflicts(options);
+	return !options.inputs.empty();
+}
+
+size_t defaultMemoryLimit() {
+#ifdef __linux__
+	const long pages = sysconf(_SC_PHYS_PAGES);
+	const long pageSize = sysconf(_SC_PAGESIZE);
+	if (pages > 0 && pageSize > 0) {
+		return static_cast<size_t>(pages) * pageSize / 2;
+	}
+#endif
+	return static_cast<size_t>(4) << 30;
+}
+
+std::string formatMegabytes(size_t bytes) {
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(1) << bytes / 1048576.0 << " MB";
+	return text.str();
+}
+
+// 峰值與當下各區段的用量，例如 "peak 120.5 MB (applyProjection 90.2 MB, Image::decode 30.3 MB)"
+std::string describePeak(const memstats::MemoryReport& report) {
+	std::string text = "peak " + formatMegabytes(report.peak);
+	for (size_t i = 0; i < report.atPeak.size(); i++) {
+		text += (i == 0 ? " (" : ", ") + report.atPeak[i].first + " " + formatMegabytes(report.atPeak[i].second);
+	}
+	if (!report.atPeak.empty()) text += ")";
+	return text;
+}
+
+int runBatch(const BatchOptions& options) {
+	using Clock = std::chrono::steady_clock;
+
+	fs::create_directories(options.outputDir);
+	if (options.memoryReport) {
+		memstats::setEnabled(true);
+	}
+	if (!options.tracePath.empty()) {
+		trace::setEnabled(true);
+		trace::setThreadName("main");
+	}
+
+	ExecutionContext ctx;
+	ctx.maxThreads = options.threads;
+
+	std::optional<ImageCache> cache;
+	if (!options.cacheDir.empty()) {
+		cache.emplace(options.cacheDir);
+	}
+	auto loadImage = [&](const std::string& path) {
+		return cache ? cache->load(path, ctx) : Image::loadFromJPG(path, ctx);
+	};
+
+	std::optional<Image> mask;
+	if (options.recipe.projection) {
+		memstats::StageScope stage("projection mask");
+		mask.emplace(loadImage(options.recipe.maskPath));
+	}
+
+	// 共用的遮罩常駐記憶體，從額度中扣除
+	size_t memoryLimit = options.memoryLimit > 0 ? options.memoryLimit : defaultMemoryLimit();
+	if (mask) {
+		memoryLimit -= std::min(memoryLimit, mask->byteSize());
+	}
+	MemoryBudget budget(memoryLimit);
+
+	// 排程前先平行讀取所有檔頭，解碼執行緒依尺寸申請額度
+	const auto probeStart = Clock::now();
+	const std::vector<ProbedImage> probed = probeImages(options.inputs, ctx);
+	const double probeSeconds = std::chrono::duration<double>(Clock::now() - probeStart).count();
+
+	const bool planar = options.ycbcr && !options.recipe.projection;
+	const size_t total = options.inputs.size();
+	BoundedQueue<Job> decoded(options.queueDepth);
+	BoundedQueue<Job> processed(options.queueDepth);
+
+	std::atomic<size_t> succeeded{ 0 };
+	std::atomic<uint64_t> pixels{ 0 };
+	std::atomic<int64_t> decodeNanos{ 0 }, processNanos{ 0 }, encodeNanos{ 0 };
+	std::mutex logMutex;
+
+	auto elapsedNanos = [](Clock::time_point start) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	};
+	auto reportError = [&](size_t index, const std::exception& e) {
+		std::lock_guard<std::mutex> lock(logMutex);
+		std::cerr << "Error: " << options.inputs[index] << ": " << e.what() << std::endl;
+	};
+
+	const auto batchStart = Clock::now();
+
+	// 快取的 key 在讀檔之前取得，解碼期間來源被替換時不會把舊像素存到新檔案的 key 下
+	// RGB 路徑上已命中快取的檔案直接映射，不交給 PrefetchReader 讀取
+	std::vector<rawimage::SourceKey> keys(total);
+	std::vector<char> keyed(total, 0);
+	std::vector<size_t> cachedInputs, readInputs;
+	std::vector<std::string> readPaths;
+	for (size_t i = 0; i < total; i++) {
+		keyed[i] = cache && ImageCache::sourceKey(options.inputs[i], keys[i]);
+		std::optional<Image> hit;
+		if (keyed[i] && !planar && cache->find(keys[i], hit)) {
+			cachedInputs.push_back(i);
+		}
+		else {
+			readInputs.push_back(i);
+			readPaths.push_back(options.inputs[i]);
+		}
+	}
+	std::atomic<size_t> nextCached{ 0 };
+
+	// 讀檔在解碼執行緒之前進行 (io_uring 或專用 I/O 執行緒)，解碼端只處理記憶體中的資料
+	PrefetchReader reader(std::move(readPaths), options.prefetch, options.decoders);
+
+	// file 為 nullptr 表示讀檔前已命中快取
+	auto decodeInput = [&](size_t index, PrefetchedFile* file) {
+		const std::string& path = options.inputs[index];
+		if (file && !file->ok()) {
+			reportError(index, std::runtime_error(file->error));
+			return;
+		}
+		// 依檔頭尺寸預估峰值申請額度後才解碼
+		// (平面路徑的實際用量低於 RGB 的預估，沿用同一個上限)
+		const ProbedImage& header = probed[index];
+		if (!header.ok) {
+			reportError(index, std::runtime_error("Failed to read image header"));
+			return;
+		}
+		Job job;
+		job.index = index;
+		job.reservation = budget.acquire(options.recipe.predictPeakBytes(header.info.width, header.info.height, header.info.channels));
+		if (options.memoryReport) job.memory = std::make_shared<memstats::Account>();
+		memstats::AccountScope account(job.memory);
+
+		TRACE_SCOPE("decode stage");
+		const auto start = Clock::now();
+		try {
+			if (!file) {
+				// 之後快取項目被清除或替換時直接讀檔解碼
+				if (!cache->find(keys[index], job.image)) {
+					job.image.emplace(Image::loadFromJPG(path, ctx));
+					cache->store(keys[index], *job.image);
+				}
+			}
+			else {
+				if (planar) {
+					try {
+						job.planar.emplace(YCbCrImage::decode(file->data.data(), file->data.size(), ctx));
+					}
+					catch (const std::exception&) {
+						// RGB / CMYK 編碼或不支援的取樣率：改走 RGB 路徑
+					}
+				}
+				if (!job.planar && !(keyed[index] && cache->find(keys[index], job.image))) {
+					job.image.emplace(Image::decode(file->data.data(), file->data.size(), ctx));
+					if (keyed[index]) cache->store(keys[index], *job.image);
+				}
+			}
+		}
+		catch (const std::exception& e) {
+			reportError(index, e);
+			return;
+		}
+		decodeNanos += elapsedNanos(start);
+		if (file) file->data.release(); // 壓縮資料用完即歸還給池
+		job.pixels = job.planar ? static_cast<uint64_t>(job.planar->getWidth()) * job.planar->getHeight()
+		                        : static_cast<uint64_t>(job.image->getWidth()) * job.image->getHeight();
+		decoded.push(std::move(job));
+	};
+
+	std::vector<std::thread> decoders;
+	for (int i = 0; i < options.decoders; i++) {
+		decoders.emplace_back([&, i] {
+			trace::setThreadName("decoder " + std::to_string(i));
+			size_t next;
+			while ((next = nextCached.fetch_add(1)) < cachedInputs.size()) {
+				decodeInput(cachedInputs[next], nullptr);
+			}
+			PrefetchedFile file;
+			while (reader.next(file)) {
+				decodeInput(readInputs[file.index], &file);
+			}
+		});
+	}
+
+	std::vector<std::thread> processors;
+	for (int i = 0; i < options.processors; i++) {
+		processors.emplace_back([&, i] {
+			trace::setThreadName("processor " + std::to_string(i));
+			Job job;
+			while (decoded.pop(job)) {
+				memstats::AccountScope account(job.memory);
+				TRACE_SCOPE("process stage");
+				const auto start = Clock::now();
+				try {
+					const Recipe& recipe = options.recipe;
+					if (job.planar) {
+						job.planar.emplace(processImage(*job.planar, recipe.brightness, recipe.contrast, recipe.saturation, recipe.temperature, ctx));
+						processNanos += elapsedNanos(start);
+						processed.push(std::move(job));
+						continue;
+					}
+					if (recipe.projection) {
+						job.image.emplace(applyProjection(*job.image, *mask, ctx));
+					}
+					job.image.emplace(processImage(*job.image, recipe.brightness, recipe.contrast, recipe.saturation, recipe.temperature, ctx));
+				}
+				catch (const std::exception& e) {
+					reportError(job.index, e);
+					job = Job(); // 歸還額度
+					continue;
+				}
+				processNanos += elapsedNanos(start);
+				processed.push(std::move(job));
+			}
+		});
+	}
+
+	std::vector<std::thread> encoders;
+	for (int i = 0; i < options.encoders; i++) {
+		encoders.emplace_back([&, i] {
+			trace::setThreadName("encoder " + std::to_string(i));
+			Job job;
+			while (processed.pop(job)) {
+				memstats::AccountScope account(job.memory);
+				TRACE_SCOPE("encode stage");
+				const auto start = Clock::now();
+				try {
+					const std::string output = outputPathFor(options, options.inputs[job.index]);
+					if (job.planar) {
+						job.planar->saveAsJPG(output, options.recipe.quality, ctx);
+					}
+					else {
+						job.image->saveAsJPG(output, options.recipe.quality, ctx);
+					}
+				}
+				catch (const std::exception& e) {
+					reportError(job.index, e);
+					job = Job(); // 歸還額度
+					continue;
+				}
+				encodeNanos += elapsedNanos(start);
+				pixels += job.pixels;
+				succeeded++;
+				if (job.memory) {
+					std::lock_guard<std::mutex> lock(logMutex);
+					std::cout << options.inputs[job.index] << ": " << describePeak(job.memory->report()) << std::endl;
+				}
+				job = Job();
+			}
+		});
+	}
+
+	for (auto& t : decoders) t.join();
+	decoded.close();
+	for (auto& t : processors) t.join();
+	processed.close();
+	for (auto& t : encoders) t.join();
+
+	const double seconds = elapsedNanos(batchStart) / 1e9;
+	const double megapixels = pixels.load() / 1e6;
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "Probed " << total << " headers in " << probeSeconds * 1000.0 << " ms" << std::endl
+		<< "Processed " << succeeded.load() << "/" << total << " images, "
+		<< megapixels << " MP in " << seconds << " s" << std::endl
+		<< "Throughput: " << succeeded.load() / seconds << " images/s, "
+		<< megapixels / seconds << " MP/s" << std::endl
+		<< "Stage busy time: decode " << decodeNanos.load() / 1e9 << " s, process "
+		<< processNanos.load() / 1e9 << " s, encode " << encodeNanos.load() / 1e9 << " s" << std::endl
+		<< "Peak predicted memory in flight: " << budget.getPeak() / 1048576.0 << " MB (budget "
+		<< budget.getCapacity() / 1048576.0 << " MB)" << std::endl;
+
+	if (options.memoryReport) {
+		const memstats::MemoryReport report = memstats::global().report();
+		std::cout << "Pixel buffers: " << describePeak(report) << std::endl;
+		for (const auto& stage : report.stages) {
+			std::cout << "  " << std::left << std::setw(24) << stage.stage << std::right
+				<< " peak " << std::setw(10) << formatMegabytes(stage.peak)
+				<< ", " << stage.allocations << " allocations, " << formatMegabytes(stage.allocated) << " total" << std::endl;
+		}
+	}
+
+	if (!options.tracePath.empty()) {
+		trace::setEnabled(false);
+		if (trace::saveChromeTrace(options.tracePath)) {
+			std::cout << "Trace written to " << options.tracePath << std::endl;
+		}
+		else {
+			std::cerr << "Error: failed to write trace " << options.tracePath << std::endl;
+		}
+	}
+
+	return succeeded.load() == total ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	BatchOptions options;
+	try {
+		if (!parseArguments(argc, argv, options)) {
+			printUsage();
+			return 2;
+		}
+		return runBatch(options);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 2;
+	}
+}
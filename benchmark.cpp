@@ -0,0 +1,667 @@
+// 效能基準測試：對 ImageProcessing.h 的每個函式與 JPEG 讀寫，掃描影像尺寸、通道數與執行緒數
+// 輸入為固定種子的合成影像；結果可另存為 CSV，用 --baseline 與先前的建置比較
+// --verify 改為正確性檢查：最佳化的濾鏡與 ReferenceFilters.h 的純量實作比較，每項檢查有最大容許誤差 (定點數灰階為 1，其餘為 0)
+#include <iostream>
+#include "Image.h"
+#include "YCbCrImage.h"
+#include "ImageProcessing.h"
+#include "ThreadPool.h"
+#include "PerfCounters.h"
+#include "ImageCompare.h"
+#include "ReferenceFilters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+	std::vector<double> megapixels = { 1, 4, 16 };
+	std::vector<int> channels = { 1, 3, 4 };
+	std::vector<int> threads;   // 空: 1, 2, 4 ... 到硬體執行緒數
+	std::string filter;         // 只跑名稱包含此字串的項目
+	int minIterations = 3;
+	double minSeconds = 0.3;    // 每個組合至少量測的時間
+	uint32_t seed = 1;
+	std::string csvPath;        // 非空時輸出 CSV ("-" 為標準輸出)
+	std::string baselinePath;   // 先前輸出的 CSV，印出相對速度
+	bool counters = false;      // 以硬體計數器量測每次呼叫的 cycles、指令、快取與 TLB 未命中
+	bool verify = false;        // 只做正確性檢查，不量測時間
+	std::vector<std::string> images; // --verify 額外使用的真實影像
+};
+
+// 同一個尺寸與通道數下所有項目共用的輸入
+struct BenchInput {
+	Image image;
+	Image mask;                        // 投影用遮罩 (單通道)
+	std::vector<uint8_t> jpeg;         // image 以品質 90 編碼
+	std::string jpegPath;              // 與 jpeg 內容相同的暫存檔
+	std::optional<YCbCrImage> planar;  // 由 jpeg 解碼的 Y / Cb / Cr 平面 (彩色才有)
+};
+
+// 量測項目：run 執行一次並回傳讀寫的位元組數 (輸入 + 輸出)
+struct BenchCase {
+	std::string name;
+	std::function<bool(int channels)> accepts;
+	std::function<size_t(const BenchInput&, const ExecutionContext&)> run;
+};
+
+struct BenchResult {
+	std::string name;
+	double megapixels;
+	int width, height, channels, threads;
+	int iterations;
+	double medianNs, minNs;
+	size_t bytes;
+	double scaling = 0; // 相對單執行緒的平行效率，沒有單執行緒結果時為 0
+	bool counted = false;
+	perfcounters::CounterValues counters;           // 每次呼叫的平均值 (所有執行緒合計)
+	std::vector<uint64_t> threadCycles;             // 每次呼叫各執行緒的 cycles (依執行緒編號)
+};
+
+void printUsage() {
+	std::cout <<
+		"Usage: benchmark [options]\n"
+		"  --sizes LIST            image sizes in megapixels (default: 1,4,16; up to 200)\n"
+		"  --channels LIST         channel counts (default: 1,3,4)\n"
+		"  --threads LIST          thread counts (default: 1,2,4,... up to hardware threads)\n"
+		"  --filter TEXT           only run cases whose name contains TEXT\n"
+		"  --iterations N          minimum timed iterations per case (default: 3)\n"
+		"  --min-time S            minimum timed seconds per case (default: 0.3)\n"
+		"  --seed N                seed for the synthetic inputs (default: 1)\n"
+		"  --csv FILE              write results as CSV (- for stdout)\n"
+		"  --baseline FILE         compare against a previous --csv output\n"
+		"  --counters              report hardware counters per call (Linux perf_event_open)\n"
+		"  --verify                check filters against the scalar reference implementations on\n"
+		"                          synthetic images and an edge-case matrix instead of timing\n"
+		"                          (threads default to 1,4; --sizes, --channels, --filter apply)\n"
+		"  --images LIST           also verify on these image files\n";
+}
+
+template <typename T>
+std::vector<T> parseList(const std::string& text, T (*convert)(const std::string&)) {
+	std::vector<T> values;
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		if (!item.empty()) values.push_back(convert(item));
+	}
+	if (values.empty()) throw std::invalid_argument("Empty list: " + text);
+	return values;
+}
+
+double toDouble(const std::string& s) { return std::stod(s); }
+int toInt(const std::string& s) { return std::stoi(s); }
+std::string toString(const std::string& s) { return s; }
+
+bool parseArguments(int argc, char** argv, BenchOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+			return argv[++i];
+		};
+
+		if (arg == "-h" || arg == "--help") return false;
+		else if (arg == "--sizes") options.megapixels = parseList<double>(value(), toDouble);
+		else if (arg == "--channels") options.channels = parseList<int>(value(), toInt);
+		else if (arg == "--threads") options.threads = parseList<int>(value(), toInt);
+		else if (arg == "--filter") options.filter = value();
+		else if (arg == "--iterations") options.minIterations = std::max(1, std::stoi(value()));
+		else if (arg == "--min-time") options.minSeconds = std::stod(value());
+		else if (arg == "--seed") options.seed = static_cast<uint32_t>(std::stoul(value()));
+		else if (arg == "--csv") options.csvPath = value();
+		else if (arg == "--baseline") options.baselinePath = value();
+		else if (arg == "--counters") options.counters = true;
+		else if (arg == "--verify") options.verify = true;
+		else if (arg == "--images") options.images = parseList<std::string>(value(), toString);
+		else throw std::invalid_argument("Unknown option: " + arg);
+	}
+
+	for (double mp : options.megapixels) {
+		if (mp <= 0 || mp > 1000) throw std::invalid_argument("Invalid size: " + std::to_string(mp));
+	}
+	for (int c : options.channels) {
+		if (c != 1 && c != 3 && c != 4) throw std::invalid_argument("Invalid channel count: " + std::to_string(c));
+	}
+	if (options.threads.empty() && options.verify) {
+		options.threads = { 1, 4 }; // 單機只有一個核心時也要涵蓋平行分塊
+	}
+	if (options.threads.empty()) {
+		const int hardware = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+		for (int t = 1; t < hardware; t *= 2) options.threads.push_back(t);
+		options.threads.push_back(hardware);
+	}
+	for (int& t : options.threads) t = std::max(1, t);
+	return true;
+}
+
+std::string formatNumber(float value) {
+	std::ostringstream text;
+	text << value;
+	return text.str();
+}
+
+// 平滑漸層加上少量雜訊，接近照片的頻譜 (純雜訊會讓 JPEG 編解碼失真地慢)
+Image makeImage(int width, int height, int channels, uint32_t seed) {
+	Image img(width, height, channels);
+	uint8_t* p = img.mutablePixels();
+	uint32_t state = seed * 2654435761u + static_cast<uint32_t>(channels);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			for (int c = 0; c < channels; c++) {
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				const int smooth = (x * (c + 1) * 255 / width + y * 255 / height + c * 40) & 255;
+				const int noise = static_cast<int>(state & 15) - 8;
+				*p++ = static_cast<uint8_t>(std::clamp(smooth + noise, 0, 255));
+			}
+		}
+	}
+	return img;
+}
+
+// 中央亮、邊緣暗的單通道遮罩
+Image makeMask(int width, int height) {
+	Image mask(width, height, 1);
+	uint8_t* p = mask.mutablePixels();
+	const float cx = width / 2.0f, cy = height / 2.0f;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const float d = std::hypot((x - cx) / cx, (y - cy) / cy);
+			*p++ = static_cast<uint8_t>(std::clamp(255.0f * (1.0f - d), 0.0f, 255.0f));
+		}
+	}
+	return mask;
+}
+
+// 與 img 同尺寸、每個像素都是 value 的單通道影像
+Image uniformMap(const Image& img, uint8_t value) {
+	Image map(img.getWidth(), img.getHeight(), 1);
+	std::fill(map.mutablePixels(), map.mutablePixels() + map.byteSize(), value);
+	return map;
+}
+
+std::vector<BenchCase> makeCases() {
+	auto any = [](int) { return true; };
+	auto color = [](int channels) { return channels >= 3; };
+	auto imageBytes = [](const BenchInput& in, const Image& out) { return in.image.byteSize() + out.byteSize(); };
+
+	std::vector<BenchCase> cases;
+	cases.push_back({ "grayscale", color, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyGrayscale(in.image, GrayscaleMode::Replicated, ctx)); } });
+	cases.push_back({ "grayscale_single", color, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyGrayscale(in.image, GrayscaleMode::SingleChannel, ctx)); } });
+	cases.push_back({ "blur_r2", any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyBlur(in.image, 2, ctx)); } });
+	cases.push_back({ "blur_r5", any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyBlur(in.image, 5, ctx)); } });
+	for (int radius : { 5, 20 }) {
+		cases.push_back({ "variable_blur_r" + std::to_string(radius), any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+			return imageBytes(in, applyVariableBlur(in.image, in.mask, radius, ctx)) + in.mask.byteSize(); } });
+	}
+	for (int radius : { 2, 10 }) {
+		cases.push_back({ "median_r" + std::to_string(radius), any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+			return imageBytes(in, applyMedian(in.image, radius, ctx)); } });
+	}
+	cases.push_back({ "invert", any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyInvertColors(in.image, ctx)); } });
+	cases.push_back({ "brightness", any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyBrightness(in.image, 20, ctx)); } });
+	cases.push_back({ "contrast", any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyContrast(in.image, 1.2f, ctx)); } });
+	cases.push_back({ "temperature", color, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyColorTemperature(in.image, 15, ctx)); } });
+	cases.push_back({ "saturation", color, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applySaturation(in.image, 1.3f, ctx)); } });
+	cases.push_back({ "projection", any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, applyProjection(in.image, in.mask, ctx)); } });
+	cases.push_back({ "process", any, [=](const BenchInput& in, const ExecutionContext& ctx) {
+		return imageBytes(in, processImage(in.image, 20, 1.2f, 1.3f, 15, ctx)); } });
+	cases.push_back({ "process_ycbcr", [](int channels) { return channels == 3; },
+		[](const BenchInput& in, const ExecutionContext& ctx) {
+			const YCbCrImage out = processImage(*in.planar, 20, 1.2f, 1.3f, 15, ctx);
+			return in.planar->byteSize() + out.byteSize(); } });
+	cases.push_back({ "encode_jpg", any, [](const BenchInput& in, const ExecutionContext& ctx) {
+		size_t written = 0;
+		in.image.encodeJPG([&](const uint8_t*, size_t size) { written += size; return true; }, 90, ctx);
+		return in.image.byteSize() + written; } });
+	cases.push_back({ "decode_jpg", any, [](const BenchInput& in, const ExecutionContext& ctx) {
+		const Image out = Image::decode(in.jpeg.data(), in.jpeg.size(), ctx);
+		return in.jpeg.size() + out.byteSize(); } });
+	cases.push_back({ "save_jpg", any, [](const BenchInput& in, const ExecutionContext& ctx) {
+		in.image.saveAsJPG(in.jpegPath + ".out.jpg", 90, ctx);
+		return in.image.byteSize() + in.jpeg.size(); } });
+	cases.push_back({ "load_jpg", any, [](const BenchInput& in, const ExecutionContext& ctx) {
+		const Image out = Image::loadFromJPG(in.jpegPath, ctx);
+		return in.jpeg.size() + out.byteSize(); } });
+	return cases;
+}
+
+// 各執行緒所有區段的計數器總和
+std::map<uint32_t, perfcounters::CounterValues> countersByThread() {
+	std::map<uint32_t, perfcounters::CounterValues> threads;
+	for (const auto& stage : perfcounters::snapshot()) threads[stage.thread] += stage.counts;
+	return threads;
+}
+
+// 先跑一次暖身，再重複到至少 minIterations 次且累計 minSeconds 秒 (最多 1000 次)
+BenchResult measure(const BenchCase& bench, const BenchInput& input, const ExecutionContext& ctx, const BenchOptions& options) {
+	BenchResult result;
+	result.bytes = bench.run(input, ctx);
+
+	std::map<uint32_t, perfcounters::CounterValues> before;
+	if (perfcounters::enabled()) before = countersByThread();
+
+	std::vector<double> samples;
+	double total = 0;
+	while (samples.size() < 1000 && (static_cast<int>(samples.size()) < options.minIterations || total < options.minSeconds)) {
+		const auto start = Clock::now();
+		bench.run(input, ctx);
+		const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		samples.push_back(seconds * 1e9);
+		total += seconds;
+	}
+	std::sort(samples.begin(), samples.end());
+	result.iterations = static_cast<int>(samples.size());
+
+	if (perfcounters::enabled()) {
+		result.counted = true;
+		for (const auto& thread : countersByThread()) {
+			perfcounters::CounterValues delta;
+			const perfcounters::CounterValues& previous = before[thread.first];
+			for (int i = 0; i < perfcounters::COUNTER_COUNT; i++) {
+				delta.values[i] = (thread.second.values[i] - previous.values[i]) / result.iterations;
+			}
+			if (delta[perfcounters::Cycles] > 0) result.threadCycles.push_back(delta[perfcounters::Cycles]);
+			result.counters += delta;
+		}
+	}
+	result.medianNs = samples[samples.size() / 2];
+	result.minNs = samples.front();
+	return result;
+}
+
+std::string resultKey(const std::string& name, double megapixels, int channels, int threads) {
+	std::ostringstream key;
+	key << name << '/' << megapixels << '/' << channels << '/' << threads;
+	return key.str();
+}
+
+// 讀取先前的 CSV，key 對應 ns/pixel
+std::map<std::string, double> loadBaseline(const std::string& path) {
+	std::ifstream in(path);
+	if (!in) throw std::runtime_error("Failed to open baseline: " + path);
+	std::map<std::string, double> baseline;
+	std::string line;
+	std::getline(in, line); // 欄位名稱
+	while (std::getline(in, line)) {
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, ',')) fields.push_back(field);
+		if (fields.size() < 10) continue;
+		baseline[resultKey(fields[0], std::stod(fields[1]), std::stoi(fields[4]), std::stoi(fields[5]))] = std::stod(fields[9]);
+	}
+	return baseline;
+}
+
+// 由每次呼叫的計數器推導的指標，計數器不可用時為 NaN
+struct CounterMetrics {
+	double cyclesPerPixel, ipc, cacheMissesPerKpx, dtlbMissesPerKpx, pageFaults;
+};
+
+CounterMetrics counterMetrics(const BenchResult& r) {
+	using namespace perfcounters;
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const double pixels = static_cast<double>(r.width) * r.height;
+	auto metric = [&](Counter counter, double value) { return r.counted && available(counter) ? value : nan; };
+	const CounterValues& c = r.counters;
+	return {
+		metric(Cycles, c[Cycles] / pixels),
+		metric(Instructions, c[Cycles] > 0 ? static_cast<double>(c[Instructions]) / c[Cycles] : nan),
+		metric(CacheMisses, c[CacheMisses] * 1000.0 / pixels),
+		metric(DtlbMisses, c[DtlbMisses] * 1000.0 / pixels),
+		metric(PageFaults, static_cast<double>(c[PageFaults])),
+	};
+}
+
+void writeCsv(std::ostream& out, const std::vector<BenchResult>& results) {
+	out << "case,megapixels,width,height,channels,threads,iterations,median_ns,min_ns,ns_per_pixel,gb_per_s,scaling_efficiency,"
+		"cycles_per_pixel,ipc,cache_misses_per_kpx,dtlb_misses_per_kpx,page_faults\n";
+	out << std::setprecision(6);
+	// 不可用的計數器留空
+	auto field = [&](double value) -> std::ostream& {
+		out << ',';
+		if (!std::isnan(value)) out << value;
+		return out;
+	};
+	for (const auto& r : results) {
+		const double pixels = static_cast<double>(r.width) * r.height;
+		out << r.name << ',' << r.megapixels << ',' << r.width << ',' << r.height << ',' << r.channels << ','
+			<< r.threads << ',' << r.iterations << ',' << std::llround(r.medianNs) << ',' << std::llround(r.minNs) << ','
+			<< r.medianNs / pixels << ',' << r.bytes / r.medianNs << ',' << r.scaling;
+		const CounterMetrics m = counterMetrics(r);
+		field(m.cyclesPerPixel);
+		field(m.ipc);
+		field(m.cacheMissesPerKpx);
+		field(m.dtlbMissesPerKpx);
+		field(m.pageFaults) << '\n';
+	}
+}
+
+int runBenchmark(const BenchOptions& options) {
+	const std::vector<BenchCase> cases = makeCases();
+	const int maxThreads = *std::max_element(options.threads.begin(), options.threads.end());
+	// 專用執行緒池依最大執行緒數建立，超過硬體執行緒數時也能量測 (呼叫端本身算一個)
+	ThreadPool pool(std::max(1, maxThreads - 1));
+
+	std::map<std::string, double> baseline;
+	if (!options.baselinePath.empty()) baseline = loadBaseline(options.baselinePath);
+
+	std::random_device random;
+	const std::string tempBase = (fs::temp_directory_path() / ("benchmark_" + std::to_string(random()))).string();
+
+	std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+	if (options.counters) {
+		if (!perfcounters::setEnabled(true)) {
+			std::cerr << "Warning: no performance counters available (perf_event_open failed)" << std::endl;
+		}
+		std::cout << "Counters:";
+		for (int i = 0; i < perfcounters::COUNTER_COUNT; i++) {
+			const auto counter = static_cast<perfcounters::Counter>(i);
+			std::cout << " " << perfcounters::counterName(counter) << (perfcounters::available(counter) ? "" : " (n/a)");
+		}
+		std::cout << std::endl;
+	}
+	std::vector<BenchResult> results;
+	for (double mp : options.megapixels) {
+		const double targetPixels = mp * 1e6;
+		const int width = std::max(1, static_cast<int>(std::lround(std::sqrt(targetPixels * 1.5))));
+		const int height = std::max(1, static_cast<int>(std::lround(targetPixels / width)));
+
+		for (int channels : options.channels) {
+			BenchInput input{ makeImage(width, height, channels, options.seed), makeMask(width, height), {}, tempBase + ".jpg", std::nullopt };
+			input.image.encodeJPG([&](const uint8_t* data, size_t size) {
+				input.jpeg.insert(input.jpeg.end(), data, data + size);
+				return true;
+			}, 90);
+			std::ofstream(input.jpegPath, std::ios::binary).write(reinterpret_cast<const char*>(input.jpeg.data()), input.jpeg.size());
+			if (channels == 3) {
+				input.planar.emplace(YCbCrImage::decode(input.jpeg.data(), input.jpeg.size()));
+			}
+
+			std::cout << std::endl << width << "x" << height << " (" << mp << " MP), " << channels << " channels" << std::endl;
+			for (const auto& bench : cases) {
+				if (!bench.accepts(channels)) continue;
+				if (!options.filter.empty() && bench.name.find(options.filter) == std::string::npos) continue;
+
+				double singleThreadNs = 0;
+				for (int threads : options.threads) {
+					ExecutionContext ctx;
+					ctx.pool = &pool;
+					ctx.maxThreads = threads;
+
+					BenchResult r = measure(bench, input, ctx, options);
+					r.name = bench.name;
+					r.megapixels = mp;
+					r.width = width;
+					r.height = height;
+					r.channels = channels;
+					r.threads = threads;
+					if (threads == 1) singleThreadNs = r.medianNs;
+					if (singleThreadNs > 0) r.scaling = singleThreadNs / (r.medianNs * threads);
+
+					const double nsPerPixel = r.medianNs / (static_cast<double>(width) * height);
+					std::ostringstream line;
+					line << std::fixed << std::setprecision(2)
+						<< "  " << std::left << std::setw(18) << r.name << std::right
+						<< std::setw(3) << threads << "T " << std::setw(10) << r.medianNs / 1e6 << " ms "
+						<< std::setw(8) << nsPerPixel << " ns/px " << std::setw(7) << r.bytes / r.medianNs << " GB/s";
+					if (r.scaling > 0 && threads > 1) line << "  eff " << r.scaling;
+					const auto base = baseline.find(resultKey(r.name, mp, channels, threads));
+					if (base != baseline.end()) line << "  x" << base->second / nsPerPixel << " vs baseline";
+					if (r.counted) {
+						// 不可用的計數器顯示 n/a
+						auto show = [&](const char* label, double value, int precision) {
+							line << "  " << label << " ";
+							if (std::isnan(value)) line << "n/a";
+							else line << std::setprecision(precision) << value;
+						};
+						const CounterMetrics m = counterMetrics(r);
+						line << std::endl << "      ";
+						show("cyc/px", m.cyclesPerPixel, 2);
+						show("IPC", m.ipc, 2);
+						show("LLC miss/kpx", m.cacheMissesPerKpx, 2);
+						show("dTLB miss/kpx", m.dtlbMissesPerKpx, 2);
+						show("faults", m.pageFaults, 0);
+						if (r.threadCycles.size() > 1 && perfcounters::available(perfcounters::Cycles)) {
+							line << "  cycles per thread";
+							for (uint64_t cycles : r.threadCycles) line << " " << std::setprecision(1) << cycles / 1e6 << "M";
+						}
+					}
+					std::cout << line.str() << std::endl;
+					results.push_back(r);
+				}
+			}
+		}
+	}
+
+	std::error_code ec;
+	fs::remove(tempBase + ".jpg", ec);
+	fs::remove(tempBase + ".jpg.out.jpg", ec);
+
+	if (options.csvPath == "-") {
+		writeCsv(std::cout, results);
+	}
+	else if (!options.csvPath.empty()) {
+		std::ofstream out(options.csvPath);
+		if (!out) throw std::runtime_error("Failed to write " + options.csvPath);
+		writeCsv(out, results);
+	}
+	return 0;
+}
+
+// 一項正確性檢查：optimized 與 expected 的最大誤差不得超過 tolerance
+struct VerifyCase {
+	std::string name;
+	int tolerance;
+	std::function<bool(const Image& img)> accepts;
+	std::function<Image(const Image& img, const Image& mask, const ExecutionContext& ctx)> optimized;
+	std::function<Image(const Image& img, const Image& mask)> expected;
+	bool heavy = false; // 參考實作太慢，真實影像與大尺寸合成影像跳過
+};
+
+std::vector<VerifyCase> makeVerifyCases() {
+	auto any = [](const Image&) { return true; };
+	std::vector<VerifyCase> cases;
+	cases.push_back({ "grayscale", 1, any,
+		[](const Image& img, const Image&, const ExecutionContext& ctx) { return applyGrayscale(img, GrayscaleMode::Replicated, ctx); },
+		[](const Image& img, const Image&) { return reference::grayscale(img, GrayscaleMode::Replicated); } });
+	cases.push_back({ "grayscale_single", 1, any,
+		[](const Image& img, const Image&, const ExecutionContext& ctx) { return applyGrayscale(img, GrayscaleMode::SingleChannel, ctx); },
+		[](const Image& img, const Image&) { return reference::grayscale(img, GrayscaleMode::SingleChannel); } });
+	for (int radius : { 1, 3 }) {
+		cases.push_back({ "blur_r" + std::to_string(radius), 0, any,
+			[radius](const Image& img, const Image&, const ExecutionContext& ctx) { return applyBlur(img, radius, ctx); },
+			[radius](const Image& img, const Image&) { return reference::blur(img, radius); } });
+	}
+	// 半徑大於影像 (只在小影像上檢查)
+	cases.push_back({ "blur_oversized", 0, [](const Image& img) { return img.getWidth() <= 64 && img.getHeight() <= 64; },
+		[](const Image& img, const Image&, const ExecutionContext& ctx) { return applyBlur(img, std::max(img.getWidth(), img.getHeight()) + 2, ctx); },
+		[](const Image& img, const Image&) { return reference::blur(img, std::max(img.getWidth(), img.getHeight()) + 2); }, true });
+	// 遮罩當作半徑圖；半徑處處相同時應與 applyBlur 的參考實作一致
+	cases.push_back({ "variable_blur", 0, any,
+		[](const Image& img, const Image& mask, const ExecutionContext& ctx) { return applyVariableBlur(img, mask, 6, ctx); },
+		[](const Image& img, const Image& mask) { return reference::variableBlur(img, mask, 6); } });
+	cases.push_back({ "variable_blur_uniform", 0, any,
+		[](const Image& img, const Image&, const ExecutionContext& ctx) { return applyVariableBlur(img, uniformMap(img, 255), 3, ctx); },
+		[](const Image& img, const Image&) { return reference::blur(img, 3); } });
+	cases.push_back({ "variable_blur_oversized", 0, [](const Image& img) { return img.getWidth() <= 64 && img.getHeight() <= 64; },
+		[](const Image& img, const Image& mask, const ExecutionContext& ctx) { return applyVariableBlur(img, mask, std::max(img.getWidth(), img.getHeight()) + 2, ctx); },
+		[](const Image& img, const Image& mask) { return reference::variableBlur(img, mask, std::max(img.getWidth(), img.getHeight()) + 2); }, true });
+	for (int radius : { 1, 2, 5 }) {
+		cases.push_back({ "median_r" + std::to_string(radius), 0, any,
+			[radius](const Image& img, const Image&, const ExecutionContext& ctx) { return applyMedian(img, radius, ctx); },
+			[radius](const Image& img, const Image&) { return reference::median(img, radius); }, radius > 2 });
+	}
+	cases.push_back({ "median_oversized", 0, [](const Image& img) { return img.getWidth() <= 64 && img.getHeight() <= 64; },
+		[](const Image& img, const Image&, const ExecutionContext& ctx) { return applyMedian(img, std::max(img.getWidth(), img.getHeight()) + 2, ctx); },
+		[](const Image& img, const Image&) { return reference::median(img, std::max(img.getWidth(), img.getHeight()) + 2); }, true });
+	cases.push_back({ "invert", 0, any,
+		[](const Image& img, const Image&, const ExecutionContext& ctx) { return applyInvertColors(img, ctx); },
+		[](const Image& img, const Image&) { return reference::invertColors(img); } });
+	for (int brightness : { 37, -60 }) {
+		cases.push_back({ "brightness" + std::to_string(brightness), 0, any,
+			[brightness](const Image& img, const Image&, const ExecutionContext& ctx) { return applyBrightness(img, brightness, ctx); },
+			[brightness](const Image& img, const Image&) { return reference::brightness(img, brightness); } });
+	}
+	for (float contrast : { 0.6f, 1.35f }) {
+		cases.push_back({ "contrast" + formatNumber(contrast), 0, any,
+			[contrast](const Image& img, const Image&, const ExecutionContext& ctx) { return applyContrast(img, contrast, ctx); },
+			[contrast](const Image& img, const Image&) { return reference::contrast(img, contrast); } });
+	}
+	for (float saturation : { 0.0f, 1.4f }) {
+		cases.push_back({ "saturation" + formatNumber(saturation), 0, any,
+			[saturation](const Image& img, const Image&, const ExecutionContext& ctx) { return applySaturation(img, saturation, ctx); },
+			[saturation](const Image& img, const Image&) { return reference::saturation(img, saturation); } });
+	}
+	cases.push_back({ "temperature", 0, any,
+		[](const Image& img, const Image&, const ExecutionContext& ctx) { return applyColorTemperature(img, 25, ctx); },
+		[](const Image& img, const Image&) { return reference::colorTemperature(img, 25); } });
+	cases.push_back({ "projection", 0, any,
+		[](const Image& img, const Image& mask, const ExecutionContext& ctx) { return applyProjection(img, mask, ctx); },
+		[](const Image& img, const Image& mask) { return reference::projection(img, mask); } });
+	for (const auto& p : { std::make_tuple(20, 1.2f, 1.3f, 15), std::make_tuple(-80, 1.8f, 0.2f, -40) }) {
+		const int brightness = std::get<0>(p);
+		const float contrast = std::get<1>(p), saturation = std::get<2>(p);
+		const int temperature = std::get<3>(p);
+		cases.push_back({ "process" + std::to_string(brightness), 0, any,
+			[=](const Image& img, const Image&, const ExecutionContext& ctx) { return processImage(img, brightness, contrast, saturation, temperature, ctx); },
+			[=](const Image& img, const Image&) { return reference::processImage(img, brightness, contrast, saturation, temperature); } });
+	}
+	return cases;
+}
+
+// 各執行緒數各跑一次最佳化版本 (另加 grainSize 1 讓每列各自成為一個區塊)，與參考結果比較
+// 回傳失敗數；quiet 時只印出失敗的項目
+int verifyImage(const std::string& label, const Image& img, const Image& mask, const std::vector<VerifyCase>& cases,
+                const BenchOptions& options, ThreadPool& pool, bool large, bool quiet, int& checks) {
+	int failures = 0;
+	for (const auto& check : cases) {
+		if (!options.filter.empty() && check.name.find(options.filter) == std::string::npos) continue;
+		if (!check.accepts(img) || (large && check.heavy)) continue;
+
+		const Image expected = check.expected(img, mask);
+		for (int threads : options.threads) {
+			for (int grain : { 0, 1 }) {
+				if (grain == 1 && threads == 1) continue;
+				ExecutionContext ctx;
+				ctx.pool = &pool;
+				ctx.maxThreads = threads;
+				ctx.grainSize = grain;
+
+				const ImageDifference diff = compareImages(expected, check.optimized(img, mask, ctx));
+				const bool ok = diff.within(check.tolerance);
+				checks++;
+				if (!ok) failures++;
+				if (quiet && ok) continue;
+
+				std::ostringstream line;
+				line << "  " << std::left << std::setw(18) << check.name << std::setw(16) << label << std::right
+					<< std::setw(3) << threads << "T" << (grain ? " g1" : "   ");
+				if (!diff.sameShape) {
+					line << "  shape mismatch";
+				}
+				else {
+					line << std::fixed << std::setprecision(4) << "  max " << std::setw(3) << diff.maxError
+						<< "  mean " << diff.meanError << "  PSNR ";
+					if (std::isinf(diff.psnr)) line << "inf";
+					else line << std::setprecision(2) << diff.psnr << " dB";
+				}
+				line << (ok ? "  ok" : "  FAILED (tolerance " + std::to_string(check.tolerance) + ")");
+				std::cout << line.str() << std::endl;
+			}
+		}
+	}
+	return failures;
+}
+
+int runVerify(const BenchOptions& options) {
+	const std::vector<VerifyCase> cases = makeVerifyCases();
+	const int maxThreads = *std::max_element(options.threads.begin(), options.threads.end());
+	ThreadPool pool(std::max(1, maxThreads - 1));
+	int failures = 0;
+	int checks = 0;
+
+	// 合成影像 (--sizes 為百萬像素，大尺寸時跳過參考實作太慢的項目)
+	std::cout << "Synthetic images" << std::endl;
+	for (double mp : options.megapixels) {
+		const double targetPixels = mp * 1e6;
+		const int width = std::max(1, static_cast<int>(std::lround(std::sqrt(targetPixels * 1.5))) | 1); // 奇數寬度
+		const int height = std::max(1, static_cast<int>(std::lround(targetPixels / width)));
+		for (int channels : options.channels) {
+			const std::string label = std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(channels);
+			failures += verifyImage(label, makeImage(width, height, channels, options.seed), makeMask(width, height),
+			                        cases, options, pool, targetPixels > 65536, false, checks);
+		}
+	}
+
+	// 真實影像
+	for (const auto& path : options.images) {
+		std::cout << path << std::endl;
+		const Image img = Image::loadFromJPG(path);
+		const std::string label = std::to_string(img.getWidth()) + "x" + std::to_string(img.getHeight()) + "x" + std::to_string(img.getChannels());
+		failures += verifyImage(label, img, makeMask(img.getWidth(), img.getHeight()), cases, options, pool, true, false, checks);
+	}
+
+	// 邊界情況：1x1、單列 / 單行、奇數寬度、半徑大於影像，三種通道數
+	const int edgeChecksBefore = checks;
+	int edgeFailures = 0;
+	std::cout << "Edge cases (failures only)" << std::endl;
+	const std::pair<int, int> sizes[] = { { 1, 1 }, { 1, 7 }, { 7, 1 }, { 2, 2 }, { 3, 5 }, { 17, 3 }, { 31, 31 }, { 101, 7 }, { 253, 101 } };
+	for (const auto& size : sizes) {
+		for (int channels : { 1, 3, 4 }) {
+			const std::string label = std::to_string(size.first) + "x" + std::to_string(size.second) + "x" + std::to_string(channels);
+			edgeFailures += verifyImage(label, makeImage(size.first, size.second, channels, options.seed + 1),
+			                            makeMask(size.first, size.second), cases, options, pool, false, true, checks);
+		}
+	}
+	failures += edgeFailures;
+	std::cout << "  " << checks - edgeChecksBefore << " checks, " << edgeFailures << " failed" << std::endl;
+
+	std::cout << std::endl << checks << " checks, " << failures << " failed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	try {
+		if (!parseArguments(argc, argv, options)) {
+			printUsage();
+			return 2;
+		}
+		return options.verify ? runVerify(options) : runBenchmark(options);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 2;
+	}
+}
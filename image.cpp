@@ -5,8 +5,65 @@
 #include "stb_image_write.h"
 
 #include "Image.h"
+#include "JpegIO.h"
+#include "RawImage.h"
+#include "Trace.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
-#include <iostream>
+
+namespace {
+    struct FileCloser {
+        void operator()(FILE* f) const { fclose(f); }
+    };
+
+    // 接手 stb_image 的解碼結果
+    Image adoptDecoded(uint8_t* imgData, int w, int h, int c) {
+        std::vector<uint8_t> data(imgData, imgData + static_cast<size_t>(w) * h * c);
+        stbi_image_free(imgData);
+        return Image(data, w, h, c);
+    }
+
+    // 把 Image::ReadFunc 接到 stb_image 的 C 回呼；回呼拋出的例外先記下，解碼結束後再拋出
+    struct CallbackReader {
+        const Image::ReadFunc* source;
+        bool ended = false;
+        std::exception_ptr error;
+
+        explicit CallbackReader(const Image::ReadFunc* source) : source(source) {}
+
+        static int read(void* user, char* data, int size) {
+            auto* reader = static_cast<CallbackReader*>(user);
+            if (reader->ended) return 0;
+            size_t count = 0;
+            try {
+                count = (*reader->source)(reinterpret_cast<uint8_t*>(data), static_cast<size_t>(size));
+            }
+            catch (...) {
+                reader->error = std::current_exception();
+            }
+            if (count == 0) reader->ended = true;
+            return static_cast<int>(std::min(count, static_cast<size_t>(size)));
+        }
+
+        // stb_image 只會往前跳，讀掉丟棄即可
+        static void skip(void* user, int n) {
+            char scratch[4096];
+            while (n > 0) {
+                const int count = read(user, scratch, std::min(n, static_cast<int>(sizeof(scratch))));
+                if (count == 0) break;
+                n -= count;
+            }
+        }
+
+        static int eof(void* user) {
+            return static_cast<CallbackReader*>(user)->ended ? 1 : 0;
+        }
+    };
+}
 
 // 構造函數
 Image::Image(int w, int h, int c) : width(w), height(h), channels(c) {
@@ -14,6 +71,7 @@ Image::Image(int w, int h, int c) : width(w), height(h), channels(c) {
         throw std::invalid_argument("Invalid image dimensions or channels.");
     }
     data.resize(w * h * c);
+    allocation = memstats::Allocation(data.size());
 }
 
 Image::Image(const std::vector<uint8_t>& rawData, int w, int h, int c)
@@ -21,29 +79,189 @@ Image::Image(const std::vector<uint8_t>& rawData, int w, int h, int c)
     if (rawData.size() != w * h * c) {
         throw std::invalid_argument("Raw data size does not match dimensions.");
     }
+    allocation = memstats::Allocation(data.size());
+}
+
+Image::Image(std::shared_ptr<const MappedFile> file, const uint8_t* first, int w, int h, int c)
+    : width(w), height(h), channels(c), mapping(std::move(file)), mapped(first) {
 }
 
 // 從 JPEG 文件加載影像
-Image Image::loadFromJPG(const std::string& filename) {
+Image Image::loadFromJPG(const std::string& filename, const ExecutionContext& ctx) {
+    return loadFromJPG(filename, JpegScale::Full, ctx);
+}
+
+// 整個檔案讀進記憶體後解碼；單執行緒且不縮小時由 stb_image 直接讀檔
+Image Image::loadFromJPG(const std::string& filename, JpegScale scale, const ExecutionContext& ctx) {
+    TRACE_SCOPE("Image::loadFromJPG");
+    std::vector<uint8_t> bytes;
+    if ((ctx.concurrency() > 1 || scale != JpegScale::Full) && jpegio::readFile(filename, bytes)) {
+        try {
+            return decode(bytes.data(), bytes.size(), scale, ctx);
+        }
+        catch (const std::runtime_error&) {
+            throw std::runtime_error("Failed to load image: " + filename);
+        }
+    }
+
     int w, h, c;
     uint8_t* imgData = stbi_load(filename.c_str(), &w, &h, &c, 0);
     if (!imgData) {
         throw std::runtime_error("Failed to load image: " + filename);
     }
+    return adoptDecoded(imgData, w, h, c);
+}
+
+// 只讀檔頭
+ImageInfo Image::probe(const std::string& filename) {
+    ImageInfo info;
+    if (!probe(filename, info)) {
+        throw std::runtime_error("Failed to read image header: " + filename);
+    }
+    return info;
+}
+
+bool Image::probe(const std::string& filename, ImageInfo& info) {
+    TRACE_SCOPE("Image::probe");
+    std::unique_ptr<FILE, FileCloser> file(fopen(filename.c_str(), "rb"));
+    if (!file) return false;
+    info = ImageInfo();
+    if (fgetc(file.get()) == 0xFF && fgetc(file.get()) == 0xD8) {
+        return jpegio::scanHeader(file.get(), info);
+    }
+    rewind(file.get());
+    return stbi_info_from_file(file.get(), &info.width, &info.height, &info.channels) != 0;
+}
 
-    // 將數據複製到 std::vector
-    std::vector<uint8_t> data(imgData, imgData + w * h * c);
-    stbi_image_free(imgData);
+Image Image::decode(const uint8_t* bytes, size_t size, const ExecutionContext& ctx) {
+    return decode(bytes, size, JpegScale::Full, ctx);
+}
+
+// 由 stb_image 依 restart interval 切分熵解碼，並分列帶做色彩轉換
+// 縮小解碼時每個 8x8 區塊只做 4x4 / 2x2 的 IDCT，1/8 倍只取 DC 係數
+Image Image::decode(const uint8_t* bytes, size_t size, JpegScale scale, const ExecutionContext& ctx) {
+    TRACE_SCOPE("Image::decode");
+    if (size > INT_MAX) {
+        throw std::invalid_argument("Encoded image is too large.");
+    }
+    const int scaleShift = scale == JpegScale::Eighth ? 3 : scale == JpegScale::Quarter ? 2 : scale == JpegScale::Half ? 1 : 0;
+    const bool parallel = ctx.concurrency() > 1;
 
-    return Image(data, w, h, c);
+    int w, h, c;
+    uint8_t* imgData = stbi_load_from_memory_scaled(bytes, static_cast<int>(size), &w, &h, &c, 0, scaleShift,
+                                                    parallel ? jpegio::runParallel : nullptr, const_cast<ExecutionContext*>(&ctx));
+    if (!imgData) {
+        throw std::runtime_error(std::string("Failed to decode image: ") + stbi_failure_reason());
+    }
+    return adoptDecoded(imgData, w, h, c);
+}
+
+Image Image::decode(const ReadFunc& read) {
+    TRACE_SCOPE("Image::decode (stream)");
+    CallbackReader reader(&read);
+    const stbi_io_callbacks callbacks = { CallbackReader::read, CallbackReader::skip, CallbackReader::eof };
+
+    int w, h, c;
+    uint8_t* imgData = stbi_load_from_callbacks(&callbacks, &reader, &w, &h, &c, 0);
+    if (reader.error) {
+        stbi_image_free(imgData);
+        std::rethrow_exception(reader.error);
+    }
+    if (!imgData) {
+        throw std::runtime_error(std::string("Failed to decode image: ") + stbi_failure_reason());
+    }
+    return adoptDecoded(imgData, w, h, c);
+}
+
+// 唯讀映射原始像素檔
+Image Image::loadRaw(const std::string& filename) {
+    TRACE_SCOPE("Image::loadRaw");
+    std::shared_ptr<const MappedFile> file = MappedFile::open(filename);
+    if (!file) {
+        throw std::runtime_error("Failed to map image: " + filename);
+    }
+    return fromMapping(std::move(file));
+}
+
+Image Image::fromMapping(std::shared_ptr<const MappedFile> file) {
+    RawImageHeader header;
+    if (!file || !rawimage::readHeader(*file, header)) {
+        throw std::runtime_error("Invalid raw image data.");
+    }
+    const int w = static_cast<int>(header.width);
+    const int h = static_cast<int>(header.height);
+    const int c = static_cast<int>(header.channels);
+    const uint8_t* first = file->data() + header.dataOffset;
+    const size_t rowBytes = static_cast<size_t>(w) * c;
+
+    if (header.pitch != rowBytes) {
+        // 列之間有填充時無法直接使用，逐列複製
+        Image result(w, h, c);
+        for (int y = 0; y < h; y++) {
+            std::copy(first + y * header.pitch, first + y * header.pitch + rowBytes, result.data.begin() + y * rowBytes);
+        }
+        return result;
+    }
+
+    return Image(std::move(file), first, w, h, c);
+}
+
+// 保存為原始像素檔
+void Image::saveRaw(const std::string& filename) const {
+    TRACE_SCOPE("Image::saveRaw");
+    if (!rawimage::write(filename, *this)) {
+        throw std::runtime_error("Failed to save raw image: " + filename);
+    }
 }
 
 // 保存影像為 JPEG
-void Image::saveAsJPG(const std::string& filename, int quality) const {
-    if (!stbi_write_jpg(filename.c_str(), width, height, channels, data.data(), quality)) {
-        throw std::runtime_error("Failed to save image as JPEG: " + filename);
+void Image::saveAsJPG(const std::string& filename, int quality, const ExecutionContext& ctx) const {
+    TRACE_SCOPE("Image::saveAsJPG");
+    jpegio::writeStriped(filename, width, height, quality, ctx, [&](int first, int last, std::vector<uint8_t>& out) {
+        return stbi_write_jpg_mcu_rows_to_func(jpegio::appendToBuffer, &out, width, height, channels,
+                                               pixels(), quality, first, last) != 0;
+    });
+}
+
+// 編碼為 JPEG 交給呼叫端的 write
+void Image::encodeJPG(const WriteFunc& write, int quality, const ExecutionContext& ctx) const {
+    TRACE_SCOPE("Image::encodeJPG");
+    const bool ok = jpegio::encodeStriped(width, height, quality, ctx, [&](int first, int last, std::vector<uint8_t>& out) {
+        return stbi_write_jpg_mcu_rows_to_func(jpegio::appendToBuffer, &out, width, height, channels,
+                                               pixels(), quality, first, last) != 0;
+    }, write);
+    if (!ok) {
+        throw std::runtime_error("Failed to encode image as JPEG.");
+    }
+}
+
+// 映射的影像在寫入前複製一份，之後與原映射無關
+void Image::detach() {
+    if (!mapped) return;
+    if (data.empty()) {
+        data.assign(mapped, mapped + byteSize());
+        allocation = memstats::Allocation(data.size());
+    }
+    mapping.reset();
+    mapped = nullptr;
+}
+
+uint8_t* Image::mutablePixels() {
+    detach();
+    return data.data();
+}
+
+const std::vector<uint8_t>& Image::getData() const {
+    if (mapped) {
+        // 多個執行緒可能同時對同一張映射影像呼叫，複製一次即可
+        static std::mutex materializeMutex;
+        std::lock_guard<std::mutex> lock(materializeMutex);
+        if (data.empty()) {
+            data.assign(mapped, mapped + byteSize());
+            allocation = memstats::Allocation(data.size());
+        }
     }
-    std::cout << "Image saved as " << filename << " with quality " << quality << "." << std::endl;
+    return data;
 }
 
 // 數據訪問
@@ -51,12 +269,12 @@ uint8_t& Image::at(int x, int y, int channel) {
     if (x < 0 || x >= width || y < 0 || y >= height || channel < 0 || channel >= channels) {
         throw std::out_of_range("Pixel access out of bounds.");
     }
-    return data[(y * width + x) * channels + channel];
+    return mutablePixels()[(y * width + x) * channels + channel];
 }
 
 const uint8_t& Image::at(int x, int y, int channel) const {
     if (x < 0 || x >= width || y < 0 || y >= height || channel < 0 || channel >= channels) {
         throw std::out_of_range("Pixel access out of bounds.");
     }
-    return data[(y * width + x) * channels + channel];
+    return pixels()[(y * width + x) * channels + channel];
 }
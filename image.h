@@ -4,30 +4,100 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <memory>
+#include <functional>
+#include "ThreadPool.h"
+#include "MemoryStats.h"
+
+class MappedFile;
+
+// 只讀檔頭取得的影像資訊
+struct ImageInfo {
+    int width = 0;
+    int height = 0;
+    int channels = 0;    // 與 loadFromJPG 解碼後的通道數相同
+    int orientation = 1; // EXIF 方向 (1-8，1 為不需旋轉)
+};
+
+// JPEG 解碼時的縮小倍率，直接在 DCT 域縮小 (用於預覽與縮圖)
+enum class JpegScale { Full = 1, Half = 2, Quarter = 4, Eighth = 8 };
 
 class Image {
 private:
     int width;                // 影像寬度
     int height;               // 影像高度
     int channels;             // 通道數 (1: 灰階, 3: RGB, 4: RGBA)
-    std::vector<uint8_t> data; // 影像數據
+    mutable std::vector<uint8_t> data; // 影像數據 (映射的影像在 getData() 時才複製)
+    mutable memstats::Allocation allocation; // data 的記帳 (映射區不計)
+    std::shared_ptr<const MappedFile> mapping; // 唯讀映射的原始像素檔，複製 Image 時共用
+    const uint8_t* mapped = nullptr;           // 映射中的像素起點，nullptr 表示使用 data
+
+    // 由 fromMapping 建立，像素直接指向映射區
+    Image(std::shared_ptr<const MappedFile> file, const uint8_t* first, int w, int h, int c);
+
+    // 映射的影像在寫入前複製成自有的 data
+    void detach();
 
 public:
+    // 串流解碼的讀取回呼：最多填入 capacity 位元組並回傳實際數量，0 表示結束
+    using ReadFunc = std::function<size_t(uint8_t* buffer, size_t capacity)>;
+    // 編碼輸出的寫入回呼，寫入失敗回傳 false
+    using WriteFunc = std::function<bool(const uint8_t* data, size_t size)>;
+
     // 構造函數
     Image(int w, int h, int c);
     Image(const std::vector<uint8_t>& rawData, int w, int h, int c);
 
-    // 從 JPEG 文件加載影像
-    static Image loadFromJPG(const std::string& filename);
+    // 從 JPEG 文件加載影像 (含 restart marker 的檔案以多執行緒解碼)
+    static Image loadFromJPG(const std::string& filename,
+                             const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+    // 以縮小的解析度加載 JPEG，寬高為原尺寸除以倍率後無條件進位 (非 JPEG 檔案維持原尺寸)
+    static Image loadFromJPG(const std::string& filename, JpegScale scale,
+                             const ExecutionContext& ctx = ExecutionContext::defaultContext());
 
-    // 保存影像為 JPEG
-    void saveAsJPG(const std::string& filename, int quality = 90) const;
+    // 只讀檔頭取得尺寸與通道數 (JPEG 掃描標記到 SOF 為止，其他格式使用 stbi_info)
+    static ImageInfo probe(const std::string& filename); // 失敗時拋出例外
+    static bool probe(const std::string& filename, ImageInfo& info);
+
+    // 從記憶體中的 JPEG (或 stb_image 支援的其他格式) 解碼，不經過檔案系統
+    static Image decode(const uint8_t* bytes, size_t size,
+                        const ExecutionContext& ctx = ExecutionContext::defaultContext());
+    static Image decode(const uint8_t* bytes, size_t size, JpegScale scale,
+                        const ExecutionContext& ctx = ExecutionContext::defaultContext());
+
+    // 邊讀邊解碼 (管線、socket 等無法先取得完整內容的來源)，固定單執行緒
+    static Image decode(const ReadFunc& read);
+
+    // 唯讀映射原始像素檔 (格式見 RawImage.h)，列緊密排列時不複製像素
+    static Image loadRaw(const std::string& filename);
+    static Image fromMapping(std::shared_ptr<const MappedFile> file);
+
+    // 保存為原始像素檔，供 loadRaw 直接映射
+    void saveRaw(const std::string& filename) const;
+
+    // 保存影像為 JPEG (大型影像以 restart interval 切成條帶並行編碼)
+    void saveAsJPG(const std::string& filename, int quality = 90,
+                   const ExecutionContext& ctx = ExecutionContext::defaultContext()) const;
+
+    // 編碼為 JPEG 交給 write，輸出在記憶體中整段累積後才呼叫 (每條帶一次)
+    void encodeJPG(const WriteFunc& write, int quality = 90,
+                   const ExecutionContext& ctx = ExecutionContext::defaultContext()) const;
 
     // 基本信息
     int getWidth() const { return width; }
     int getHeight() const { return height; }
     int getChannels() const { return channels; }
-    const std::vector<uint8_t>& getData() const { return data; }
+    size_t byteSize() const { return static_cast<size_t>(width) * height * channels; }
+    bool isMapped() const { return mapped != nullptr; }
+
+    // 像素起點，列緊密排列
+    const uint8_t* pixels() const { return mapped ? mapped : data.data(); }
+    // 可寫入的像素起點，映射的影像會先複製一份
+    uint8_t* mutablePixels();
+
+    // 舊介面：映射的影像第一次呼叫時才複製成 std::vector，新程式碼請改用 pixels()
+    const std::vector<uint8_t>& getData() const;
 
     // 數據訪問
     uint8_t& at(int x, int y, int channel);
@@ -1,15 +1,20 @@
 #include <iostream>
 #include "Image.h"
+#include "ImageCache.h"
 #include "ImageProcessing.h"
+#include "Trace.h"
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
 #include <SDL_ttf.h> // 用於顯示文字
 #include <vector>
 #include <cstdint>
 #include <algorithm>
+#include <chrono>
+#include <fstream>
 
 #include <sstream>
 #include <iomanip> // for std::setprecision
+#include <cmath>
 
 std::string formatFloat(float value, int decimalPlaces) {
 	std::ostringstream stream;
@@ -17,6 +22,105 @@ std::string formatFloat(float value, int decimalPlaces) {
 	return stream.str();
 }
 
+struct ViewerOptions {
+	std::string recordPath;  // 把輸入事件與時間寫到這個檔案
+	std::string replayPath;  // 依錄製的時間送出事件，取代即時輸入；送完後結束
+	bool headless = false;   // 使用 SDL 的 dummy 視訊驅動，不開實際的視窗
+	bool latency = false;    // 結束時印出每幀延遲的百分位數 (重播時一律印出)
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point from, Clock::time_point to) {
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// 錄製檔一行一個事件，時間為距離第一幀的毫秒數：
+//   <ms> quit | <ms> key <keycode> | <ms> click <button> <x> <y> | <ms> wheel <x> <y>
+struct RecordedEvent {
+	double timeMs;
+	SDL_Event event;
+};
+
+bool isInputEvent(const SDL_Event& e) {
+	return e.type == SDL_QUIT || e.type == SDL_KEYDOWN || e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_MOUSEWHEEL;
+}
+
+void writeEvent(std::ostream& out, double timeMs, const SDL_Event& e) {
+	out << std::fixed << std::setprecision(3) << timeMs;
+	if (e.type == SDL_QUIT) out << " quit";
+	else if (e.type == SDL_KEYDOWN) out << " key " << e.key.keysym.sym;
+	else if (e.type == SDL_MOUSEBUTTONDOWN) out << " click " << static_cast<int>(e.button.button) << " " << e.button.x << " " << e.button.y;
+	else if (e.type == SDL_MOUSEWHEEL) out << " wheel " << e.wheel.x << " " << e.wheel.y;
+	out << "\n";
+}
+
+bool loadEvents(const std::string& path, std::vector<RecordedEvent>& events) {
+	std::ifstream in(path);
+	if (!in) {
+		std::cerr << "Failed to open replay file " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(in, line)) {
+		lineNumber++;
+		if (line.empty() || line[0] == '#') continue;
+		std::istringstream fields(line);
+		RecordedEvent recorded{};
+		std::string type;
+		fields >> recorded.timeMs >> type;
+		SDL_Event& e = recorded.event;
+		if (type == "quit") {
+			e.type = SDL_QUIT;
+		}
+		else if (type == "key") {
+			e.type = SDL_KEYDOWN;
+			fields >> e.key.keysym.sym;
+		}
+		else if (type == "click") {
+			int button = 0;
+			fields >> button >> e.button.x >> e.button.y;
+			e.type = SDL_MOUSEBUTTONDOWN;
+			e.button.button = static_cast<Uint8>(button);
+		}
+		else if (type == "wheel") {
+			e.type = SDL_MOUSEWHEEL;
+			fields >> e.wheel.x >> e.wheel.y;
+		}
+		else {
+			fields.setstate(std::ios::failbit);
+		}
+		if (!fields) {
+			std::cerr << path << ":" << lineNumber << ": invalid event \"" << line << "\"" << std::endl;
+			return false;
+		}
+		events.push_back(recorded);
+	}
+	std::stable_sort(events.begin(), events.end(), [](const RecordedEvent& a, const RecordedEvent& b) { return a.timeMs < b.timeMs; });
+	return true;
+}
+
+// 最近秩百分位數
+double percentile(std::vector<double> values, double p) {
+	if (values.empty()) return 0;
+	std::sort(values.begin(), values.end());
+	const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+	return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+}
+
+void printLatency(const std::string& name, const std::vector<double>& values) {
+	std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2);
+	if (values.empty()) {
+		std::cout << "       -" << std::endl;
+		return;
+	}
+	for (double p : { 50.0, 90.0, 99.0, 100.0 }) {
+		std::cout << std::setw(9) << percentile(values, p);
+	}
+	std::cout << std::setw(8) << values.size() << std::endl;
+}
+
 // 初始化 SDL 字型系統（需要安裝 SDL_ttf）
 bool initFont(TTF_Font*& font) {
 	if (TTF_Init() == -1) {
@@ -58,8 +162,21 @@ void renderTextRight(SDL_Renderer* renderer, TTF_Font* font, const std::string&
 
 
 
-void displayImage() {
+void displayImage(const ViewerOptions& options) {
+	std::vector<RecordedEvent> replay;
+	if (!options.replayPath.empty() && !loadEvents(options.replayPath, replay)) return;
+	std::ofstream recording;
+	if (!options.recordPath.empty()) {
+		recording.open(options.recordPath);
+		if (!recording) {
+			std::cerr << "Failed to open record file " << options.recordPath << std::endl;
+			return;
+		}
+	}
 
+	if (options.headless) {
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+	}
 	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
 		std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
 		return;
@@ -72,8 +189,8 @@ void displayImage() {
 	}
 
 
-	// 複製原始圖像
-	Image image = Image::loadFromJPG("paranoma.JPEG");
+	// 複製原始圖像 (第二次啟動起直接映射快取的原始像素，不再解碼)
+	Image image = ImageCache().load("paranoma.JPEG");
 	std::cout << "Loaded image: " << image.getWidth() << "x" << image.getHeight() << ", " << image.getChannels() << " channels." << std::endl;
 
 	int screenWidth = 1024;
@@ -97,6 +214,10 @@ void displayImage() {
 	}
 
 	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+	if (!renderer) {
+		// dummy 視訊驅動沒有硬體加速，改用軟體繪製
+		renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+	}
 	if (!renderer) {
 		std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
 		SDL_DestroyWindow(window);
@@ -132,64 +253,91 @@ void displayImage() {
 	bool cylindricalProjection = false; // 投影模式開關
 	bool isProjectionApplied = false;   // 投影是否已經應用
 
-	while (!quit) {
-
-		while (SDL_PollEvent(&e)) {
-			if (e.type == SDL_QUIT) {
-				quit = true;
+	auto handleEvent = [&](const SDL_Event& event) {
+		if (event.type == SDL_QUIT) {
+			quit = true;
+		}
+		else if (event.type == SDL_KEYDOWN) {
+			// Q 切換到調整亮度, W 切換到調整對比度
+			if (event.key.keysym.sym == SDLK_q) {
+				selectedParameter = 0; // 調整亮度
+			}
+			else if (event.key.keysym.sym == SDLK_w) {
+				selectedParameter = 1; // 調整對比度
+			}
+			else if (event.key.keysym.sym == SDLK_p) {
+				cylindricalProjection = true; // 啟用投影
 			}
-			else if (e.type == SDL_KEYDOWN) {
-				// Q 切換到調整亮度, W 切換到調整對比度
-				if (e.key.keysym.sym == SDLK_q) {
-					selectedParameter = 0; // 調整亮度
-				}
-				else if (e.key.keysym.sym == SDLK_w) {
-					selectedParameter = 1; // 調整對比度
-				}
-				else if (e.key.keysym.sym == SDLK_p) {
-					cylindricalProjection = true; // 啟用投影
-				}
 
+		}
+		else if (event.type == SDL_MOUSEBUTTONDOWN) {
+			// 設定新的縮放中心點
+			if (event.button.button == SDL_BUTTON_LEFT) {
+				int mouseX = event.button.x;
+				int mouseY = event.button.y;
+
+				// 將鼠標點轉換為圖像中的位置
+				centerX = srcRect.x + static_cast<int>(mouseX * srcRect.w / displayWidth);
+				centerY = srcRect.y + static_cast<int>(mouseY * srcRect.h / displayHeight);
 			}
-			else if (e.type == SDL_MOUSEBUTTONDOWN) {
-				// 設定新的縮放中心點
-				if (e.button.button == SDL_BUTTON_LEFT) {
-					int mouseX = e.button.x;
-					int mouseY = e.button.y;
-
-					// 將鼠標點轉換為圖像中的位置
-					centerX = srcRect.x + static_cast<int>(mouseX * srcRect.w / displayWidth);
-					centerY = srcRect.y + static_cast<int>(mouseY * srcRect.h / displayHeight);
-				}
+		}
+		else if (event.type == SDL_MOUSEWHEEL) {
+			// 滑鼠滾輪控制參數
+			if (selectedParameter == 0) { // 調整亮度
+				brightness += event.wheel.y * 5; // 每次滾動調整 5
+				brightness = std::clamp(brightness, -100, 100); // 限制亮度範圍
 			}
-			else if (e.type == SDL_MOUSEWHEEL) {
-				// 滑鼠滾輪控制參數
-				if (selectedParameter == 0) { // 調整亮度
-					brightness += e.wheel.y * 5; // 每次滾動調整 5
-					brightness = std::clamp(brightness, -100, 100); // 限制亮度範圍
-				}
-				else if (selectedParameter == 1) { // 調整對比度
-					contrast += e.wheel.y * 0.1f; // 每次滾動調整 0.1
-					contrast = std::clamp(contrast, 0.5f, 2.0f); // 限制對比度範圍
-				}
-				else if (selectedParameter == 2) { // 調整縮放比例
-					scale += e.wheel.y * 0.1f; // 每次滾動縮放 10%
-					scale = std::clamp(scale, 0.1f, 4.0f); // 限制縮放比例
-
-					// 更新裁剪區域（源矩形）
-					int newWidth = static_cast<int>(imgWidth / scale);
-					int newHeight = static_cast<int>(imgHeight / scale);
-					srcRect.w = newWidth;
-					srcRect.h = newHeight;
-
-					int maxX = std::max(0, imgWidth - newWidth);  // 確保最大值不為負
-					int maxY = std::max(0, imgHeight - newHeight); // 確保最大值不為負
-
-					srcRect.x = std::clamp(centerX - newWidth / 2, 0, maxX);
-					srcRect.y = std::clamp(centerY - newHeight / 2, 0, maxY);
-				}
+			else if (selectedParameter == 1) { // 調整對比度
+				contrast += event.wheel.y * 0.1f; // 每次滾動調整 0.1
+				contrast = std::clamp(contrast, 0.5f, 2.0f); // 限制對比度範圍
+			}
+			else if (selectedParameter == 2) { // 調整縮放比例
+				scale += event.wheel.y * 0.1f; // 每次滾動縮放 10%
+				scale = std::clamp(scale, 0.1f, 4.0f); // 限制縮放比例
+
+				// 更新裁剪區域（源矩形）
+				int newWidth = static_cast<int>(imgWidth / scale);
+				int newHeight = static_cast<int>(imgHeight / scale);
+				srcRect.w = newWidth;
+				srcRect.h = newHeight;
+
+				int maxX = std::max(0, imgWidth - newWidth);  // 確保最大值不為負
+				int maxY = std::max(0, imgHeight - newHeight); // 確保最大值不為負
+
+				srcRect.x = std::clamp(centerX - newWidth / 2, 0, maxX);
+				srcRect.y = std::clamp(centerY - newHeight / 2, 0, maxY);
 			}
 		}
+	};
+
+	// 每幀的處理 (事件、濾鏡、上傳紋理)、繪製與輸入到畫面更新的延遲
+	std::vector<double> processTimes, presentTimes, frameTimes, inputLatencies;
+	std::vector<double> inputTimes;
+	const bool replaying = !options.replayPath.empty();
+	size_t nextReplay = 0;
+	const auto sessionStart = Clock::now();
+
+	while (!quit) {
+		TRACE_SCOPE("frame");
+		const auto frameStart = Clock::now();
+		inputTimes.clear();
+
+		// 即時輸入 (重播時只處理關閉視窗)
+		while (SDL_PollEvent(&e)) {
+			if (!isInputEvent(e) || (replaying && e.type != SDL_QUIT)) continue;
+			// SDL 的事件時間戳記是毫秒，換算成距離第一幀的時間
+			const double eventMs = std::max(0.0, elapsedMs(sessionStart, Clock::now()) - static_cast<Uint32>(SDL_GetTicks() - e.common.timestamp));
+			if (recording.is_open()) writeEvent(recording, eventMs, e);
+			handleEvent(e);
+			inputTimes.push_back(eventMs);
+		}
+		// 重播到期的錄製事件，全部送出後這一幀結束就離開
+		while (nextReplay < replay.size() && replay[nextReplay].timeMs <= elapsedMs(sessionStart, Clock::now())) {
+			handleEvent(replay[nextReplay].event);
+			inputTimes.push_back(replay[nextReplay].timeMs);
+			nextReplay++;
+		}
+		if (replaying && nextReplay == replay.size()) quit = true;
 
 		if (cylindricalProjection && !isProjectionApplied) {
 			double R = 340;
@@ -199,6 +347,7 @@ void displayImage() {
 			const std::string outputFilename = "output_paranoma.jpg";
 			const int quality = 100;
 			image.saveAsJPG(outputFilename, quality);
+			std::cout << "Image saved as " << outputFilename << " with quality " << quality << "." << std::endl;
 			std::cout << "apply CylindricalProjection !" << std::endl;
 		} 
 
@@ -232,14 +381,21 @@ void displayImage() {
 			destRect.y = (displayHeight - destRect.h) / 2;
 		}
 		// 更新紋理
-		if (texture) {
-			SDL_DestroyTexture(texture); // 釋放舊紋理
+		{
+			TRACE_SCOPE("upload texture");
+			if (texture) {
+				SDL_DestroyTexture(texture); // 釋放舊紋理
+			}
+			texture = SDL_CreateTexture(
+				renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
+				modifiedImage.getWidth(), modifiedImage.getHeight()
+			);
+			SDL_UpdateTexture(texture, nullptr, modifiedImage.pixels(), imgWidth * modifiedImage.getChannels());
 		}
-		texture = SDL_CreateTexture(
-			renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
-			modifiedImage.getWidth(), modifiedImage.getHeight()
-		);
-		SDL_UpdateTexture(texture, nullptr, modifiedImage.getData().data(), imgWidth * modifiedImage.getChannels());
+
+		// 以下到本輪結束都算繪製
+		TRACE_SCOPE("draw");
+		const auto drawStart = Clock::now();
 
 		// 清屏
 		SDL_RenderClear(renderer);
@@ -281,6 +437,24 @@ void displayImage() {
 
 		// 更新畫面
 		SDL_RenderPresent(renderer);
+
+		const auto frameEnd = Clock::now();
+		processTimes.push_back(elapsedMs(frameStart, drawStart));
+		presentTimes.push_back(elapsedMs(drawStart, frameEnd));
+		frameTimes.push_back(elapsedMs(frameStart, frameEnd));
+		for (double inputMs : inputTimes) {
+			inputLatencies.push_back(elapsedMs(sessionStart, frameEnd) - inputMs);
+		}
+	}
+
+	if (options.latency || replaying) {
+		std::cout << std::endl << "Frame latency (ms)" << std::endl
+			<< std::left << std::setw(10) << "" << std::right
+			<< std::setw(9) << "p50" << std::setw(9) << "p90" << std::setw(9) << "p99" << std::setw(9) << "max" << std::setw(8) << "count" << std::endl;
+		printLatency("process", processTimes);
+		printLatency("present", presentTimes);
+		printLatency("frame", frameTimes);
+		printLatency("input", inputLatencies); // 事件發生到處理它的那一幀畫面更新完成
 	}
 
 	TTF_CloseFont(font);
@@ -290,8 +464,57 @@ void displayImage() {
 	SDL_Quit();
 }
 
-int main() {
-	displayImage();
+void printUsage() {
+	std::cerr <<
+		"Usage: viewer [options]\n"
+		"  --trace FILE            write per-frame stage timings as Chrome trace JSON on exit\n"
+		"  --record FILE           record input events with their timestamps\n"
+		"  --replay FILE           replay recorded events instead of live input, then exit\n"
+		"  --headless              use the SDL dummy video driver (no window)\n"
+		"  --latency               print frame latency percentiles on exit\n"
+		"  -h, --help              show this help\n";
+}
+
+// 未知選項或缺少參數值時回傳 false
+bool parseArguments(int argc, char** argv, std::string& tracePath, ViewerOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool takesValue = arg == "--trace" || arg == "--record" || arg == "--replay";
+		if (takesValue && i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		if (arg == "--trace") tracePath = argv[++i];
+		else if (arg == "--record") options.recordPath = argv[++i];
+		else if (arg == "--replay") options.replayPath = argv[++i];
+		else if (arg == "--headless") options.headless = true;
+		else if (arg == "--latency") options.latency = true;
+		else {
+			if (arg != "-h" && arg != "--help") std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	// 例如 viewer --replay session.txt --headless 可在沒有顯示器的環境量測互動效能
+	std::string tracePath;
+	ViewerOptions options;
+	if (!parseArguments(argc, argv, tracePath, options)) {
+		printUsage();
+		return 2;
+	}
+	if (!tracePath.empty()) {
+		trace::setEnabled(true);
+		trace::setThreadName("main");
+	}
+
+	displayImage(options);
+
+	if (!tracePath.empty() && !trace::saveChromeTrace(tracePath)) {
+		std::cerr << "Failed to write trace " << tracePath << std::endl;
+	}
 	return 0;
 }
 
@@ -270,6 +270,12 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// Where the compiler can build them, AVX2 versions of the IDCT, the 2x
+// chroma upsamplers and the YCbCr->RGB conversion are also compiled in and
+// used instead of the SSE2 ones when a run-time check finds AVX2. Their
+// output is identical to the SSE2 kernels. Define STBI_NO_AVX2 to leave
+// them out.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
@@ -423,6 +429,39 @@ typedef struct
 STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int *x, int *y, int *channels_in_file, int desired_channels);
 
+// parallel_for must call task(arg, i) once for every i in [0, count), possibly
+// concurrently, and return only after all of them have finished
+typedef void stbi_parallel_for_func(void *user, int count, void (*task)(void *arg, int index), void *arg);
+
+// Same as stbi_load_from_memory, but baseline JPEG scans with restart markers
+// are entropy-decoded one restart interval per task, and JPEG upsampling and
+// color conversion run in bands of rows, all through parallel_for. Scans
+// without restart markers are decoded serially.
+STBIDEF stbi_uc *stbi_load_from_memory_parallel(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, stbi_parallel_for_func *parallel_for, void *user);
+
+// Same again, but a JPEG is decoded straight to 1/(1<<jpeg_scale_shift) of
+// its size (shift 0..3, i.e. 1/1, 1/2, 1/4, 1/8; *x and *y are rounded up)
+// with a reduced IDCT, or just the DC coefficients at 1/8. Other formats are
+// returned at full size. parallel_for may be NULL.
+STBIDEF stbi_uc *stbi_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, int jpeg_scale_shift, stbi_parallel_for_func *parallel_for, void *user);
+
+// The Y, Cb and Cr planes of a JPEG as stored in the file, i.e. before chroma
+// upsampling and color conversion. Each plane is packed (stride = its width).
+typedef struct
+{
+   int w, h;                            // image size, also the size of the y plane
+   int chroma_w, chroma_h;              // size of the cb and cr planes (0 for greyscale)
+   int chroma_shift_x, chroma_shift_y;  // cb/cr have 1/(1<<shift) the resolution in each axis, rounded up
+   stbi_uc *y, *cb, *cr;                // cb and cr are NULL for greyscale
+} stbi_jpeg_planes;
+
+// Decodes a YCbCr or greyscale JPEG into planes at its native subsampling
+// (chroma at 1x or 1/2 in each axis). Returns 0 for anything else, including
+// RGB or CMYK JPEGs, which have to go through the normal loaders. Free the
+// result with stbi_jpeg_planes_free. parallel_for may be NULL.
+STBIDEF int  stbi_load_jpeg_planes_from_memory(stbi_uc const *buffer, int len, stbi_jpeg_planes *planes, stbi_parallel_for_func *parallel_for, void *user);
+STBIDEF void stbi_jpeg_planes_free(stbi_jpeg_planes *planes);
+
 #ifndef STBI_NO_STDIO
 STBIDEF stbi_uc *stbi_load            (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
 STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels);
@@ -774,6 +813,35 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 kernels are compiled for a per-function target and picked at runtime,
+// so they need a compiler that can do that: MSVC 2013+, gcc 4.9+ or clang
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG) \
+   && (defined(_MSC_VER) ? _MSC_VER >= 1800 : (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7) return 0;
+   __cpuid(info, 1);
+   // AVX plus OS support for saving the ymm registers
+   if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) return 0;
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+static int stbi__avx2_available(void)
+{
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -817,6 +885,10 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   stbi_parallel_for_func *parallel_for;
+   void *parallel_user;
+   int jpeg_scale_shift;
 } stbi__context;
 
 
@@ -830,6 +902,9 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
    s->callback_already_read = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
+   s->parallel_for = NULL;
+   s->parallel_user = NULL;
+   s->jpeg_scale_shift = 0;
 }
 
 // initialize a callback-based context
@@ -841,6 +916,9 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->read_from_callbacks = 1;
    s->callback_already_read = 0;
    s->img_buffer = s->img_buffer_original = s->buffer_start;
+   s->parallel_for = NULL;
+   s->parallel_user = NULL;
+   s->jpeg_scale_shift = 0;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
 }
@@ -1433,6 +1511,22 @@ STBIDEF stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, i
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF stbi_uc *stbi_load_from_memory_parallel(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, stbi_parallel_for_func *parallel_for, void *user)
+{
+   return stbi_load_from_memory_scaled(buffer, len, x, y, comp, req_comp, 0, parallel_for, user);
+}
+
+STBIDEF stbi_uc *stbi_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int jpeg_scale_shift, stbi_parallel_for_func *parallel_for, void *user)
+{
+   stbi__context s;
+   if (jpeg_scale_shift < 0 || jpeg_scale_shift > 3) return stbi__errpuc("bad scale", "JPEG scale must be 1/1, 1/2, 1/4 or 1/8");
+   stbi__start_mem(&s,buffer,len);
+   s.parallel_for = parallel_for;
+   s.parallel_user = user;
+   s.jpeg_scale_shift = jpeg_scale_shift;
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+}
+
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
 {
    stbi__context s;
@@ -1993,11 +2087,13 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale_shift; // decode at 1/(1<<scale_shift) size, each 8x8 block becomes (8>>scale_shift)^2 pixels
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_h_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
 
 static int stbi__build_huffman(stbi__huffman *h, int *count)
@@ -2523,6 +2619,52 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced-size IDCTs for decoding at 1/2 and 1/4 scale: an NxN inverse DCT
+// of the lowest NxN coefficients gives the block downsampled to NxN.
+// k[x*N+u] = C(u) * cos((2x+1)*u*pi/(2N)) / 2, scaled by 1<<11
+static const int stbi__idct_k4[16] = { 724, 946, 724, 392,  724, 392,-724,-946,  724,-392,-724, 946,  724,-946, 724,-392 };
+static const int stbi__idct_k2[4] = { 724, 724,  724,-724 };
+
+stbi_inline static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], const int *k, int n)
+{
+   int i,j,u,tmp[16];
+   // columns, keeping 2 extra bits of precision
+   for (j=0; j < n; ++j) {
+      for (u=0; u < n; ++u) {
+         int sum = 0;
+         for (i=0; i < n; ++i)
+            sum += k[j*n+i] * data[i*8+u];
+         tmp[j*n+u] = (sum + 256) >> 9;
+      }
+   }
+   // rows
+   for (j=0; j < n; ++j, out += out_stride) {
+      for (i=0; i < n; ++i) {
+         int sum = 0;
+         for (u=0; u < n; ++u)
+            sum += k[i*n+u] * tmp[j*n+u];
+         out[i] = stbi__clamp(((sum + 4096) >> 13) + 128);
+      }
+   }
+}
+
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct_k4, 4);
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct_k2, 2);
+}
+
+// 1/8 scale only needs the DC coefficient, which is 8x the block average
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2704,6 +2846,170 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// the sse2 IDCT with the 32-bit intermediates of each row handled as one
+// 8-lane vector instead of two 4-lane halves. same arithmetic, so it's
+// bit-identical to the generic C version as well.
+STBI__AVX2_TARGET
+static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_set1_epi32((int) (((unsigned int) (unsigned short) (y) << 16) | (unsigned short) (x)))
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(packed); \
+         out1 = _mm256_extracti128_si256(packed, 1); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2931,6 +3237,10 @@ static stbi_uc stbi__get_marker(stbi__jpeg *j)
 // of the components is specified by order[]
 #define STBI__RESTART(x)     ((x) >= 0xd0 && (x) <= 0xd7)
 
+// where the idct output of block (bx,by) of component n goes
+#define stbi__jpeg_block_out(z,n,bx,by) \
+   ((z)->img_comp[n].data + (z)->img_comp[n].w2*(((by)*8) >> (z)->scale_shift) + (((bx)*8) >> (z)->scale_shift))
+
 // after a restart interval, stbi__jpeg_reset the entropy decoder and
 // the dc prediction
 static void stbi__jpeg_reset(stbi__jpeg *j)
@@ -2964,7 +3274,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, j), z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2988,11 +3298,11 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
+                        int x2 = i*z->img_comp[n].h + x;
+                        int y2 = j*z->img_comp[n].v + y;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        z->idct_block_kernel(stbi__jpeg_block_out(z, n, x2, y2), z->img_comp[n].w2, data);
                      }
                   }
                }
@@ -3070,6 +3380,141 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
    }
 }
 
+// decode baseline MCUs [first, last) of the current scan, in the same order as above
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int last)
+{
+   STBI_SIMD_ALIGN(short, data[64]);
+   int m;
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      int w = (z->img_comp[n].x+7) >> 3;
+      int ha = z->img_comp[n].ha;
+      for (m=first; m < last; ++m) {
+         int i = m % w, j = m / w;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, j), z->img_comp[n].w2, data);
+      }
+   } else {
+      int k,x,y;
+      for (m=first; m < last; ++m) {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = i*z->img_comp[n].h + x;
+                  int y2 = j*z->img_comp[n].v + y;
+                  int ha = z->img_comp[n].ha;
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  z->idct_block_kernel(stbi__jpeg_block_out(z, n, x2, y2), z->img_comp[n].w2, data);
+               }
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc **segment; // restart interval i spans segment[i]..segment[i+1], including the marker that ends it
+   int intervals, intervals_per_task, mcus;
+   int *result;       // per task: 1 ok, 0 corrupt, -1 out of memory
+} stbi__jpeg_parallel_scan;
+
+static void stbi__jpeg_decode_intervals_task(void *arg, int task)
+{
+   stbi__jpeg_parallel_scan *p = (stbi__jpeg_parallel_scan *) arg;
+   int first = task * p->intervals_per_task;
+   int last = first + p->intervals_per_task < p->intervals ? first + p->intervals_per_task : p->intervals;
+   int i;
+   stbi__context s;
+   stbi__jpeg *z = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!z) { p->result[task] = -1; return; }
+   // each task decodes with its own bit reader and DC predictors; the huffman
+   // and quantization tables are read-only copies, output blocks don't overlap
+   memcpy(z, p->z, sizeof(stbi__jpeg));
+   z->s = &s;
+   p->result[task] = 1;
+   for (i=first; i < last; ++i) {
+      int mcu_begin = i * z->restart_interval;
+      int mcu_end = mcu_begin + z->restart_interval < p->mcus ? mcu_begin + z->restart_interval : p->mcus;
+      stbi__start_mem(&s, p->segment[i], (int) (p->segment[i+1] - p->segment[i]));
+      stbi__jpeg_reset(z);
+      if (!stbi__jpeg_decode_mcus(z, mcu_begin, mcu_end)) { p->result[task] = 0; break; }
+   }
+   STBI_FREE(z);
+}
+
+// restart intervals are independent, so a baseline scan that has them can be
+// split at its RSTn markers and decoded concurrently. returns -1 if the scan
+// has to go through the serial decoder instead (nothing has been consumed then)
+static int stbi__parse_entropy_coded_data_parallel(stbi__jpeg *z)
+{
+   stbi__context *s = z->s;
+   stbi__jpeg_parallel_scan p;
+   stbi_uc *c, *end = s->img_buffer_end;
+   unsigned char marker = 0;
+   int found = 0, tasks, i, result = 1;
+
+   if (!s->parallel_for || s->read_from_callbacks || z->progressive || z->restart_interval <= 0)
+      return -1;
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      p.mcus = ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   } else
+      p.mcus = z->img_mcu_x * z->img_mcu_y;
+   p.intervals = (p.mcus + z->restart_interval - 1) / z->restart_interval;
+   if (p.intervals < 2) return -1;
+
+   p.segment = (stbi_uc **) stbi__malloc_mad2(p.intervals + 1, sizeof(stbi_uc *), 0);
+   if (!p.segment) return -1;
+   p.segment[0] = s->img_buffer;
+   for (c = s->img_buffer; c + 1 < end; ) {
+      c = (stbi_uc *) memchr(c, 0xff, end - c - 1);
+      if (!c) break;
+      if (c[1] == 0x00) { c += 2; continue; } // stuffed 0xff
+      if (c[1] == 0xff) { c += 1; continue; } // fill byte
+      if (STBI__RESTART(c[1])) {
+         if (found + 1 >= p.intervals || c[1] != 0xd0 + (found & 7)) break;
+         p.segment[++found] = c + 2;
+         c += 2;
+         continue;
+      }
+      marker = c[1];
+      break;
+   }
+   // missing, extra or out-of-order markers: leave it to the serial decoder
+   if (!marker || found != p.intervals - 1) {
+      STBI_FREE(p.segment);
+      return -1;
+   }
+   p.segment[p.intervals] = c + 2;
+
+   tasks = p.intervals < 256 ? p.intervals : 256;
+   p.intervals_per_task = (p.intervals + tasks - 1) / tasks;
+   tasks = (p.intervals + p.intervals_per_task - 1) / p.intervals_per_task;
+   p.result = (int *) stbi__malloc_mad2(tasks, sizeof(int), 0);
+   if (!p.result) {
+      STBI_FREE(p.segment);
+      return -1;
+   }
+   p.z = z;
+   s->parallel_for(s->parallel_user, tasks, stbi__jpeg_decode_intervals_task, &p);
+   for (i=0; i < tasks; ++i) {
+      if (p.result[i] < 0) { result = stbi__err("outofmem", "Out of memory"); break; }
+      if (p.result[i] == 0) result = stbi__err("bad huffman code", "Corrupt JPEG");
+   }
+   STBI_FREE(p.result);
+   STBI_FREE(p.segment);
+
+   // continue after the marker that ended the scan, as the serial decoder would
+   s->img_buffer = c + 2;
+   z->marker = marker;
+   return result;
+}
+
 static void stbi__jpeg_dequantize(short *data, stbi__uint16 *dequant)
 {
    int i;
@@ -3089,7 +3534,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, j), z->img_comp[n].w2, data);
             }
          }
       }
@@ -3329,8 +3774,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      z->img_comp[i].w2 = (z->img_mcu_x * z->img_comp[i].h * 8) >> z->scale_shift;
+      z->img_comp[i].h2 = (z->img_mcu_y * z->img_comp[i].v * 8) >> z->scale_shift;
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3340,10 +3785,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // coefficients are kept for every full-size 8x8 block
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3421,8 +3866,11 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
+         int r;
          if (!stbi__process_scan_header(j)) return 0;
-         if (!stbi__parse_entropy_coded_data(j)) return 0;
+         r = stbi__parse_entropy_coded_data_parallel(j);
+         if (r < 0) r = stbi__parse_entropy_coded_data(j);
+         if (!r) return 0;
          if (j->marker == STBI__MARKER_none ) {
          j->marker = stbi__skip_jpeg_junk_at_end(j);
             // if we reach eof without hitting a marker, stbi__get_marker() below will fail and we'll eventually return 0
@@ -3817,12 +4265,202 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// same filter as stbi__resample_row_h_2, 16 input pixels at a time
+STBI__AVX2_TARGET
+static stbi_uc *stbi__resample_row_h_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i;
+   stbi_uc *input = in_near;
+   __m256i two = _mm256_set1_epi16(2);
+
+   if (w == 1) {
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = stbi__div4(input[0]*3 + input[1] + 2);
+   // the last pixel needs the boundary condition, so the vector loop stops before it
+   for (i=1; i+16 < w; i += 16) {
+      __m256i prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i - 1)));
+      __m256i curr = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i)));
+      __m256i next = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i + 1)));
+      __m256i n    = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(curr, 1), curr), two);
+      __m256i even = _mm256_srli_epi16(_mm256_add_epi16(n, prev), 2);
+      __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(n, next), 2);
+      // both phases fit in a byte, so interleave them as the two halves of each 16-bit lane
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_or_si256(even, _mm256_slli_epi16(odd, 8)));
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = stbi__div4(n+input[i-1]);
+      out[i*2+1] = stbi__div4(n+input[i+1]);
+   }
+   out[i*2+0] = stbi__div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+
+   STBI_NOTUSED(in_far);
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+// the sse2 hv_2 filter on 16 pixels at a time
+STBI__AVX2_TARGET
+static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass: 3*near + far = 4*near + (far - near)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // "prev" / "next" are curr shifted by one pixel across the 128-bit lanes,
+      // with the neighbours outside this group of 16 filled in
+      __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+      __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+      __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+      __m256i next = _mm256_insert_epi16(nxt0, 3*in_near[i+16] + in_far[i+16], 15);
+
+      // even pixels = 3*cur + prev, odd pixels = 3*cur + next
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), bias);
+      __m256i even = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb), 4);
+      __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(_mm256_sub_epi16(next, curr), curb), 4);
+
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_or_si256(even, _mm256_slli_epi16(odd, 8)));
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+// the sse2 color transform on 16 pixels at a time, for both step 4 and step 3
+STBI__AVX2_TARGET
+static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 3 || step == 4) {
+      __m256i signflip  = _mm256_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+      // drops the alpha byte of each pixel, packing 4 pixels into the low 12 bytes of a lane
+      __m256i rgb_only = _mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+                                          0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+
+      for (; i+15 < count; i += 16) {
+         // load and widen, with y as (y << 8) + 128 and cr, cb as (c - 128) << 8
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i))), 8), y_bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr+i)), _mm256_castsi256_si128(signflip))), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb+i)), _mm256_castsi256_si128(signflip))), 8);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte and interleave, per 128-bit lane:
+         // o0 = pixels 0-3 | 8-11, o1 = pixels 4-7 | 12-15
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+         __m256i p0 = _mm256_permute2x128_si256(o0, o1, 0x20); // pixels 0-7
+         __m256i p1 = _mm256_permute2x128_si256(o0, o1, 0x31); // pixels 8-15
+
+         if (step == 4) {
+            _mm256_storeu_si256((__m256i *) (out + 0), p0);
+            _mm256_storeu_si256((__m256i *) (out + 32), p1);
+            out += 64;
+         } else {
+            // each 16-byte store leaves 4 junk bytes that the next one overwrites;
+            // the last group is stored as 8+4 bytes so nothing is written past pixel 15
+            __m256i q0 = _mm256_shuffle_epi8(p0, rgb_only);
+            __m256i q1 = _mm256_shuffle_epi8(p1, rgb_only);
+            __m128i q1hi = _mm256_extracti128_si256(q1, 1);
+            _mm_storeu_si128((__m128i *) (out + 0), _mm256_castsi256_si128(q0));
+            _mm_storeu_si128((__m128i *) (out + 12), _mm256_extracti128_si256(q0, 1));
+            _mm_storeu_si128((__m128i *) (out + 24), _mm256_castsi256_si128(q1));
+            _mm_storel_epi64((__m128i *) (out + 36), q1hi);
+            *(int *) (out + 44) = _mm_cvtsi128_si32(_mm_srli_si128(q1hi, 8));
+            out += 48;
+         }
+      }
+   }
+
+   for (; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr* stbi__float2fixed(1.40200f);
+      g = y_fixed + cr*-stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                                   +   cb* stbi__float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[0] = (stbi_uc)r;
+      out[1] = (stbi_uc)g;
+      out[2] = (stbi_uc)b;
+      out[3] = 255;
+      out += step;
+   }
+}
+#endif // STBI_AVX2
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+   j->resample_row_h_2_kernel = stbi__resample_row_h_2;
 
 #ifdef STBI_SSE2
    if (stbi__sse2_available()) {
@@ -3832,6 +4470,15 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+      j->resample_row_h_2_kernel = stbi__resample_row_h_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3862,6 +4509,172 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
+// set up the resampler of component k so that it produces output row 'row' next
+static void stbi__jpeg_init_resample(stbi__jpeg *z, stbi__resample *r, int k, int row)
+{
+   int steps, wraps, last = z->img_comp[k].y - 1;
+   int i0, i1;
+
+   r->hs      = z->img_h_max / z->img_comp[k].h;
+   r->vs      = z->img_v_max / z->img_comp[k].v;
+   r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
+
+   // state after 'row' steps of stbi__jpeg_resample_rows, starting from ystep = vs/2
+   steps      = (r->vs >> 1) + row;
+   wraps      = steps / r->vs;
+   i1         = wraps < last ? wraps : last;
+   i0         = wraps - 1 < last ? wraps - 1 : last;
+   r->ystep   = steps % r->vs;
+   r->ypos    = wraps;
+   r->line0   = z->img_comp[k].data + z->img_comp[k].w2 * (i0 > 0 ? i0 : 0);
+   r->line1   = z->img_comp[k].data + z->img_comp[k].w2 * i1;
+
+   if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+   else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
+   else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
+   else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
+   else                               r->resample = stbi__resample_row_generic;
+}
+
+// resample and color-convert output rows [row_begin, row_end); output points at row_begin.
+// like the serial loop this writes one byte past the end of the last row when n == 3
+static void stbi__jpeg_resample_rows(stbi__jpeg *z, stbi__resample *res_comp, stbi_uc **linebuf, stbi_uc *output,
+                                     int n, int decode_n, int is_rgb, int row_begin, int row_end)
+{
+   int k;
+   unsigned int i,j;
+   stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+
+   for (j=row_begin; j < (unsigned int) row_end; ++j) {
+      stbi_uc *out = output + n * z->s->img_x * (j - row_begin);
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(linebuf[k],
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                  out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], m);
+                  out[1] = stbi__blinn_8x8(255 - out[1], m);
+                  out[2] = stbi__blinn_8x8(255 - out[2], m);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               out[3] = 255; // not used if n==3
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+               out[0] = stbi__compute_y(r, g, b);
+               out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+         }
+      }
+   }
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *output;
+   int n, decode_n, is_rgb, rows_per_task;
+   int *result; // per task: 1 ok, 0 out of memory
+} stbi__jpeg_parallel_convert;
+
+static void stbi__jpeg_convert_task(void *arg, int task)
+{
+   stbi__jpeg_parallel_convert *p = (stbi__jpeg_parallel_convert *) arg;
+   stbi__jpeg *z = p->z;
+   int row_begin = task * p->rows_per_task;
+   int row_end = row_begin + p->rows_per_task < (int) z->s->img_y ? row_begin + p->rows_per_task : (int) z->s->img_y;
+   stbi__resample res_comp[4];
+   stbi_uc *linebuf[4] = { NULL, NULL, NULL, NULL };
+   // line buffers, plus the last row of the band, so its spare byte can't land in the next band
+   int row_bytes = p->n * z->s->img_x;
+   stbi_uc *buffer = (stbi_uc *) stbi__malloc_mad2(p->decode_n, z->s->img_x + 3, row_bytes + 1);
+   stbi_uc *last_row = buffer + p->decode_n * (z->s->img_x + 3);
+   int k;
+
+   p->result[task] = buffer != NULL;
+   if (!buffer) return;
+   for (k=0; k < p->decode_n; ++k) {
+      linebuf[k] = buffer + k * (z->s->img_x + 3);
+      stbi__jpeg_init_resample(z, &res_comp[k], k, row_begin);
+   }
+   stbi__jpeg_resample_rows(z, res_comp, linebuf, p->output + (size_t) row_bytes * row_begin, p->n, p->decode_n, p->is_rgb, row_begin, row_end - 1);
+   stbi__jpeg_resample_rows(z, res_comp, linebuf, last_row, p->n, p->decode_n, p->is_rgb, row_end - 1, row_end);
+   memcpy(p->output + (size_t) row_bytes * (row_end - 1), last_row, row_bytes);
+   STBI_FREE(buffer);
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
@@ -3873,6 +4686,17 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // from here on work with the reduced size the blocks were decoded at
+   if (z->scale_shift) {
+      int k, round = (1 << z->scale_shift) - 1;
+      z->s->img_x = (z->s->img_x + round) >> z->scale_shift;
+      z->s->img_y = (z->s->img_y + round) >> z->scale_shift;
+      for (k=0; k < z->s->img_n; ++k) {
+         z->img_comp[k].x = (z->s->img_x * z->img_comp[k].h + z->img_h_max-1) / z->img_h_max;
+         z->img_comp[k].y = (z->s->img_y * z->img_comp[k].v + z->img_v_max-1) / z->img_v_max;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3889,10 +4713,8 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
    // resample and color-convert
    {
-      int k;
-      unsigned int i,j;
+      int k, rows_per_task, tasks;
       stbi_uc *output;
-      stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
 
       stbi__resample res_comp[4];
 
@@ -3904,118 +4726,40 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
          if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
-         r->ystep   = r->vs >> 1;
-         r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
-         r->ypos    = 0;
-         r->line0   = r->line1 = z->img_comp[k].data;
-
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
-         else                               r->resample = stbi__resample_row_generic;
+         stbi__jpeg_init_resample(z, r, k, 0);
       }
 
-      // can't error after this so, this is safe
       output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
       if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+      // now go ahead and resample, in bands of rows if we can run them in parallel
+      rows_per_task = z->img_v_max * 8 * 4;
+      tasks = (z->s->img_y + rows_per_task - 1) / rows_per_task;
+      if (z->s->parallel_for && tasks > 1) {
+         stbi__jpeg_parallel_convert p;
+         p.z = z;
+         p.output = output;
+         p.n = n;
+         p.decode_n = decode_n;
+         p.is_rgb = is_rgb;
+         p.rows_per_task = rows_per_task;
+         p.result = (int *) stbi__malloc_mad2(tasks, sizeof(int), 0);
+         if (!p.result) { STBI_FREE(output); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         z->s->parallel_for(z->s->parallel_user, tasks, stbi__jpeg_convert_task, &p);
+         for (k=0; k < tasks; ++k) {
+            if (!p.result[k]) {
+               STBI_FREE(p.result);
+               STBI_FREE(output);
+               stbi__cleanup_jpeg(z);
+               return stbi__errpuc("outofmem", "Out of memory");
             }
          }
+         STBI_FREE(p.result);
+      } else {
+         stbi_uc *linebuf[4] = { NULL, NULL, NULL, NULL };
+         for (k=0; k < decode_n; ++k)
+            linebuf[k] = z->img_comp[k].linebuf;
+         stbi__jpeg_resample_rows(z, res_comp, linebuf, output, n, decode_n, is_rgb, 0, z->s->img_y);
       }
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
@@ -4034,11 +4778,98 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
+   j->scale_shift = s->jpeg_scale_shift;
+   if (j->scale_shift == 1) j->idct_block_kernel = stbi__idct_block_4x4;
+   if (j->scale_shift == 2) j->idct_block_kernel = stbi__idct_block_2x2;
+   if (j->scale_shift == 3) j->idct_block_kernel = stbi__idct_block_1x1;
    result = load_jpeg_image(j, x,y,comp,req_comp);
    STBI_FREE(j);
    return result;
 }
 
+// decodes the scan(s) and copies out the component planes without resampling
+static int stbi__jpeg_load_planes(stbi__jpeg *z, stbi_jpeg_planes *p)
+{
+   int k, n, shift_x = 0, shift_y = 0;
+   size_t luma, chroma;
+   z->s->img_n = 0; // make stbi__cleanup_jpeg safe
+
+   if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return 0; }
+
+   n = z->s->img_n;
+   if (n != 1 && (n != 3 || z->rgb == 3 || (z->app14_color_transform == 0 && !z->jfif))) {
+      stbi__cleanup_jpeg(z);
+      return stbi__err("not YCbCr", "JPEG components are not YCbCr");
+   }
+   if (n == 3) {
+      // luma at full resolution, cb and cr subsampled alike by 1 or 2 in each axis
+      int h = z->img_comp[1].h, v = z->img_comp[1].v;
+      if (z->img_comp[0].h != z->img_h_max || z->img_comp[0].v != z->img_v_max
+          || z->img_comp[2].h != h || z->img_comp[2].v != v
+          || (z->img_h_max != h && z->img_h_max != 2*h) || (z->img_v_max != v && z->img_v_max != 2*v)) {
+         stbi__cleanup_jpeg(z);
+         return stbi__err("bad subsampling", "Unsupported JPEG chroma subsampling");
+      }
+      shift_x = z->img_h_max != h;
+      shift_y = z->img_v_max != v;
+   }
+
+   if (!stbi__mad3sizes_valid(z->s->img_x, z->s->img_y, 3, 0)) {
+      stbi__cleanup_jpeg(z);
+      return stbi__err("too large", "Image too large to decode");
+   }
+   p->w = z->s->img_x;
+   p->h = z->s->img_y;
+   if (n == 3) {
+      p->chroma_w = z->img_comp[1].x;
+      p->chroma_h = z->img_comp[1].y;
+      p->chroma_shift_x = shift_x;
+      p->chroma_shift_y = shift_y;
+   }
+   luma = (size_t) p->w * p->h;
+   chroma = (size_t) p->chroma_w * p->chroma_h;
+   p->y = (stbi_uc *) stbi__malloc(luma + 2 * chroma);
+   if (!p->y) { stbi__cleanup_jpeg(z); return stbi__err("outofmem", "Out of memory"); }
+   if (n == 3) {
+      p->cb = p->y + luma;
+      p->cr = p->cb + chroma;
+   }
+
+   for (k=0; k < n; ++k) {
+      stbi_uc *out = k == 0 ? p->y : k == 1 ? p->cb : p->cr;
+      int j, w = z->img_comp[k].x;
+      for (j=0; j < z->img_comp[k].y; ++j)
+         memcpy(out + (size_t) j * w, z->img_comp[k].data + (size_t) j * z->img_comp[k].w2, w);
+   }
+   stbi__cleanup_jpeg(z);
+   return 1;
+}
+
+STBIDEF int stbi_load_jpeg_planes_from_memory(stbi_uc const *buffer, int len, stbi_jpeg_planes *planes, stbi_parallel_for_func *parallel_for, void *user)
+{
+   int r;
+   stbi__context s;
+   stbi__jpeg *j;
+   memset(planes, 0, sizeof(*planes));
+   stbi__start_mem(&s,buffer,len);
+   s.parallel_for = parallel_for;
+   s.parallel_user = user;
+   j = (stbi__jpeg*) stbi__malloc(sizeof(stbi__jpeg));
+   if (!j) return stbi__err("outofmem", "Out of memory");
+   memset(j, 0, sizeof(stbi__jpeg));
+   j->s = &s;
+   stbi__setup_jpeg(j);
+   r = stbi__jpeg_load_planes(j, planes);
+   STBI_FREE(j);
+   return r;
+}
+
+STBIDEF void stbi_jpeg_planes_free(stbi_jpeg_planes *planes)
+{
+   STBI_FREE(planes->y);
+   memset(planes, 0, sizeof(*planes));
+}
+
 static int stbi__jpeg_test(stbi__context *s)
 {
    int r;
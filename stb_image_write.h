@@ -64,6 +64,27 @@ USAGE:
    where the callback is:
       void stbi_write_func(void *context, void *data, int size);
 
+   A JPEG can also be written in independently encoded stripes of MCU rows
+   (an MCU is stbi_write_jpg_mcu_height(quality) pixels tall), e.g. to encode
+   the stripes on several threads:
+
+     int stbi_write_jpg_header_to_func(stbi_write_func *func, void *context, int x, int y, int comp, int quality, int restart_interval);
+     int stbi_write_jpg_mcu_rows_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int quality, int mcu_row_begin, int mcu_row_end);
+
+   Write the header with restart_interval = (MCUs per row) * (MCU rows per
+   stripe), then each stripe in order separated by the restart markers
+   0xFF,0xD0+(n&7) (n = 0 for the first marker), and finally the EOI marker
+   0xFF,0xD9. Each stripe starts with fresh DC predictors and ends byte-aligned.
+
+   Image data that is already YCbCr (e.g. the planes of a decoded JPEG) can be
+   encoded without going through RGB:
+
+     int stbi_write_jpg_planes_to_func(stbi_write_func *func, void *context, int x, int y, const stbi_write_jpg_planes *planes, int quality);
+     int stbi_write_jpg_planes_mcu_rows_to_func(stbi_write_func *func, void *context, int x, int y, const stbi_write_jpg_planes *planes, int quality, int mcu_row_begin, int mcu_row_end);
+
+   The chroma planes may be at full resolution or halved in either axis;
+   they are averaged down or repeated to the subsampling the quality selects.
+
    You can configure it with these global variables:
       int stbi_write_tga_with_rle;             // defaults to true; set to 0 to disable RLE
       int stbi_write_png_compression_level;    // defaults to 8; set to higher for more compression
@@ -106,6 +127,10 @@ USAGE:
    TGA supports RLE or non-RLE compressed data. To use non-RLE-compressed
    data, set the global variable 'stbi_write_tga_with_rle' to 0.
 
+   On x86 the JPEG writer picks SSE4.1 or AVX2 versions of the color
+   conversion, forward DCT and quantization at run time; they produce the
+   same output as the C versions. Define STBIW_NO_SIMD to leave them out.
+
    JPEG does ignore alpha channels in input data; quality is between 1 and 100.
    Higher quality looks better but results in a bigger image.
    JPEG baseline (no JPEG progressive).
@@ -192,6 +217,24 @@ STBIWDEF int stbi_write_tga_to_func(stbi_write_func *func, void *context, int w,
 STBIWDEF int stbi_write_hdr_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const float *data);
 STBIWDEF int stbi_write_jpg_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void  *data, int quality);
 
+// Pieces of a baseline JPEG with restart intervals, so MCU rows can be entropy-coded independently
+STBIWDEF int stbi_write_jpg_mcu_height(int quality);
+STBIWDEF int stbi_write_jpg_header_to_func(stbi_write_func *func, void *context, int x, int y, int comp, int quality, int restart_interval);
+STBIWDEF int stbi_write_jpg_mcu_rows_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void  *data, int quality, int mcu_row_begin, int mcu_row_end);
+
+// Y, Cb, Cr planes in JPEG's range (Cb/Cr centred on 128). The chroma planes
+// are ((x + (1<<chroma_shift_x) - 1) >> chroma_shift_x) wide and likewise tall;
+// shifts are 0 or 1. cb and cr may be NULL for a greyscale image.
+typedef struct
+{
+   const unsigned char *y, *cb, *cr;
+   int y_stride, chroma_stride;          // bytes per row
+   int chroma_shift_x, chroma_shift_y;
+} stbi_write_jpg_planes;
+
+STBIWDEF int stbi_write_jpg_planes_to_func(stbi_write_func *func, void *context, int x, int y, const stbi_write_jpg_planes *planes, int quality);
+STBIWDEF int stbi_write_jpg_planes_mcu_rows_to_func(stbi_write_func *func, void *context, int x, int y, const stbi_write_jpg_planes *planes, int quality, int mcu_row_begin, int mcu_row_end);
+
 STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 
 #endif//INCLUDE_STB_IMAGE_WRITE_H
@@ -773,7 +816,7 @@ static int stbi_write_hdr_core(stbi__write_context *s, int x, int y, int comp, f
 #ifdef __STDC_LIB_EXT1__
       len = sprintf_s(buffer, sizeof(buffer), "EXPOSURE=          1.0000000000000\n\n-Y %d +X %d\n", y, x);
 #else
-      len = sprintf_s(buffer, "EXPOSURE=          1.0000000000000\n\n-Y %d +X %d\n", y, x);
+      len = sprintf(buffer, "EXPOSURE=          1.0000000000000\n\n-Y %d +X %d\n", y, x);
 #endif
       s->func(s->context, buffer, len);
 
@@ -1256,9 +1299,9 @@ static void stbiw__jpg_writeBits(stbi__write_context *s, int *bitBufP, int *bitC
    bitBuf |= bs[0] << (24 - bitCnt);
    while(bitCnt >= 8) {
       unsigned char c = (bitBuf >> 16) & 255;
-      stbiw__putc(s, c);
+      stbiw__write1(s, c);
       if(c == 255) {
-         stbiw__putc(s, 0);
+         stbiw__write1(s, 0);
       }
       bitBuf <<= 8;
       bitCnt -= 8;
@@ -1325,11 +1368,14 @@ static void stbiw__jpg_calcBits(int val, unsigned short bits[2]) {
    bits[0] = val & ((1<<bits[1])-1);
 }
 
-static int stbiw__jpg_processDU(stbi__write_context *s, int *bitBuf, int *bitCnt, float *CDU, int du_stride, float *fdtbl, int DC, const unsigned short HTDC[256][2], const unsigned short HTAC[256][2]) {
-   const unsigned short EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
-   const unsigned short M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
-   int dataOff, i, j, n, diff, end0pos, x, y;
-   int DU[64];
+// forward DCT of one 8x8 block (in place), then quantize/descale/zigzag it into DU
+typedef void stbiw__jpg_fdct_func(float *CDU, int du_stride, const float *fdtbl, int *DU);
+
+// converts n pixels of 'comp' interleaved channels to level-shifted Y, Cb, Cr
+typedef void stbiw__jpg_color_func(float *Y, float *U, float *V, const unsigned char *p, int comp, int n);
+
+static void stbiw__jpg_fdct_quant(float *CDU, int du_stride, const float *fdtbl, int *DU) {
+   int dataOff, i, j, n, x, y;
 
    // DCT rows
    for(dataOff=0, n=du_stride*8; dataOff<n; dataOff+=du_stride) {
@@ -1351,6 +1397,342 @@ static int stbiw__jpg_processDU(stbi__write_context *s, int *bitBuf, int *bitCnt
          DU[stbiw__jpg_ZigZag[j]] = (int)(v < 0 ? v - 0.5f : v + 0.5f);
       }
    }
+}
+
+static void stbiw__jpg_color(float *Y, float *U, float *V, const unsigned char *p, int comp, int n) {
+   // comp == 2 is grey+alpha (alpha is ignored)
+   int i, ofsG = comp > 2 ? 1 : 0, ofsB = comp > 2 ? 2 : 0;
+   for(i = 0; i < n; ++i, p += comp) {
+      float r = p[0], g = p[ofsG], b = p[ofsB];
+      Y[i]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
+      U[i]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
+      V[i]= +0.50000f*r - 0.41869f*g - 0.08131f*b;
+   }
+}
+
+// The SIMD kernels below do the same float operations in the same order as
+// the C code above (no FMA), so the output doesn't depend on which one runs.
+#if !defined(STBIW_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) \
+   && (defined(_MSC_VER) ? _MSC_VER >= 1800 : (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define STBIW_SIMD
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STBIW__SSE41_TARGET
+#define STBIW__AVX2_TARGET
+// 0 = neither, 1 = SSE4.1, 2 = AVX2
+static int stbiw__simd_level(void)
+{
+   int info[4], max_leaf;
+   __cpuid(info, 0);
+   max_leaf = info[0];
+   __cpuid(info, 1);
+   if ((info[2] & (1 << 19)) == 0) return 0;
+   // AVX plus OS support for saving the ymm registers
+   if (max_leaf < 7 || (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) return 1;
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) ? 2 : 1;
+}
+#else
+#define STBIW__SSE41_TARGET __attribute__((target("sse4.1")))
+#define STBIW__AVX2_TARGET __attribute__((target("avx2")))
+static int stbiw__simd_level(void)
+{
+   if (__builtin_cpu_supports("avx2")) return 2;
+   return __builtin_cpu_supports("sse4.1") ? 1 : 0;
+}
+#endif
+
+// 8 columns of stbiw__jpg_DCT at once, one vector per input row
+STBIW__SSE41_TARGET
+static void stbiw__jpg_DCT_sse41(__m128 *d) {
+   const __m128 c4 = _mm_set1_ps(0.707106781f), c6 = _mm_set1_ps(0.382683433f);
+   const __m128 c2mc6 = _mm_set1_ps(0.541196100f), c2pc6 = _mm_set1_ps(1.306562965f);
+   __m128 z1, z2, z3, z4, z5, z11, z13;
+
+   __m128 tmp0 = _mm_add_ps(d[0], d[7]);
+   __m128 tmp7 = _mm_sub_ps(d[0], d[7]);
+   __m128 tmp1 = _mm_add_ps(d[1], d[6]);
+   __m128 tmp6 = _mm_sub_ps(d[1], d[6]);
+   __m128 tmp2 = _mm_add_ps(d[2], d[5]);
+   __m128 tmp5 = _mm_sub_ps(d[2], d[5]);
+   __m128 tmp3 = _mm_add_ps(d[3], d[4]);
+   __m128 tmp4 = _mm_sub_ps(d[3], d[4]);
+
+   // Even part
+   __m128 tmp10 = _mm_add_ps(tmp0, tmp3);
+   __m128 tmp13 = _mm_sub_ps(tmp0, tmp3);
+   __m128 tmp11 = _mm_add_ps(tmp1, tmp2);
+   __m128 tmp12 = _mm_sub_ps(tmp1, tmp2);
+
+   d[0] = _mm_add_ps(tmp10, tmp11);
+   d[4] = _mm_sub_ps(tmp10, tmp11);
+
+   z1 = _mm_mul_ps(_mm_add_ps(tmp12, tmp13), c4);
+   d[2] = _mm_add_ps(tmp13, z1);
+   d[6] = _mm_sub_ps(tmp13, z1);
+
+   // Odd part
+   tmp10 = _mm_add_ps(tmp4, tmp5);
+   tmp11 = _mm_add_ps(tmp5, tmp6);
+   tmp12 = _mm_add_ps(tmp6, tmp7);
+
+   z5 = _mm_mul_ps(_mm_sub_ps(tmp10, tmp12), c6);
+   z2 = _mm_add_ps(_mm_mul_ps(tmp10, c2mc6), z5);
+   z4 = _mm_add_ps(_mm_mul_ps(tmp12, c2pc6), z5);
+   z3 = _mm_mul_ps(tmp11, c4);
+
+   z11 = _mm_add_ps(tmp7, z3);
+   z13 = _mm_sub_ps(tmp7, z3);
+
+   d[5] = _mm_add_ps(z13, z2);
+   d[3] = _mm_sub_ps(z13, z2);
+   d[1] = _mm_add_ps(z11, z4);
+   d[7] = _mm_sub_ps(z11, z4);
+}
+
+// 8x8 transpose of a block held as left (columns 0-3) and right (columns 4-7) halves
+STBIW__SSE41_TARGET
+static void stbiw__jpg_transpose_sse41(__m128 *lo, __m128 *hi) {
+   __m128 t;
+   int i;
+   _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+   _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+   _MM_TRANSPOSE4_PS(lo[4], lo[5], lo[6], lo[7]);
+   _MM_TRANSPOSE4_PS(hi[4], hi[5], hi[6], hi[7]);
+   for(i = 0; i < 4; ++i) {
+      t = hi[i]; hi[i] = lo[i+4]; lo[i+4] = t;
+   }
+}
+
+STBIW__SSE41_TARGET
+static void stbiw__jpg_fdct_quant_sse41(float *CDU, int du_stride, const float *fdtbl, int *DU) {
+   __m128 lo[8], hi[8];
+   const __m128 sign = _mm_set1_ps(-0.0f), half = _mm_set1_ps(0.5f);
+   int i, q[64];
+
+   for(i = 0; i < 8; ++i) {
+      lo[i] = _mm_loadu_ps(CDU + i*du_stride);
+      hi[i] = _mm_loadu_ps(CDU + i*du_stride + 4);
+   }
+   // rows, then columns
+   stbiw__jpg_transpose_sse41(lo, hi);
+   stbiw__jpg_DCT_sse41(lo);
+   stbiw__jpg_DCT_sse41(hi);
+   stbiw__jpg_transpose_sse41(lo, hi);
+   stbiw__jpg_DCT_sse41(lo);
+   stbiw__jpg_DCT_sse41(hi);
+
+   // round half away from zero, as (int)(v < 0 ? v - 0.5f : v + 0.5f)
+   for(i = 0; i < 8; ++i) {
+      __m128 v0 = _mm_mul_ps(lo[i], _mm_loadu_ps(fdtbl + i*8));
+      __m128 v1 = _mm_mul_ps(hi[i], _mm_loadu_ps(fdtbl + i*8 + 4));
+      v0 = _mm_add_ps(v0, _mm_or_ps(_mm_and_ps(v0, sign), half));
+      v1 = _mm_add_ps(v1, _mm_or_ps(_mm_and_ps(v1, sign), half));
+      _mm_storeu_si128((__m128i *) (q + i*8), _mm_cvttps_epi32(v0));
+      _mm_storeu_si128((__m128i *) (q + i*8 + 4), _mm_cvttps_epi32(v1));
+   }
+   for(i = 0; i < 64; ++i) {
+      DU[stbiw__jpg_ZigZag[i]] = q[i];
+   }
+}
+
+// n must be a multiple of 4
+STBIW__SSE41_TARGET
+static void stbiw__jpg_color_sse41(float *Y, float *U, float *V, const unsigned char *p, int comp, int n) {
+   const __m128i mask = _mm_set1_epi32(0xff);
+   const __m128i rgb_to_32 = _mm_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1);
+   const __m128 yr = _mm_set1_ps(0.29900f), yg = _mm_set1_ps(0.58700f), yb = _mm_set1_ps(0.11400f), ybias = _mm_set1_ps(128.0f);
+   const __m128 ur = _mm_set1_ps(-0.16874f), ug = _mm_set1_ps(0.33126f), ub = _mm_set1_ps(0.50000f);
+   const __m128 vr = _mm_set1_ps(0.50000f), vg = _mm_set1_ps(0.41869f), vb = _mm_set1_ps(0.08131f);
+   int i;
+
+   for(i = 0; i < n; i += 4, p += 4*comp) {
+      __m128i ri, gi, bi;
+      __m128 r, g, b;
+      if(comp >= 3) {
+         __m128i px;
+         if(comp == 4) {
+            px = _mm_loadu_si128((const __m128i *) p);
+         } else {
+            int last;
+            STBIW_MEMMOVE(&last, p + 8, 4);
+            px = _mm_shuffle_epi8(_mm_insert_epi32(_mm_loadl_epi64((const __m128i *) p), last, 2), rgb_to_32);
+         }
+         ri = _mm_and_si128(px, mask);
+         gi = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+         bi = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+      } else {
+         // grey or grey+alpha: r = g = b
+         if(comp == 1) {
+            int four;
+            STBIW_MEMMOVE(&four, p, 4);
+            ri = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(four));
+         } else {
+            ri = _mm_and_si128(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) p)), mask);
+         }
+         gi = bi = ri;
+      }
+      r = _mm_cvtepi32_ps(ri);
+      g = _mm_cvtepi32_ps(gi);
+      b = _mm_cvtepi32_ps(bi);
+      _mm_storeu_ps(Y+i, _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(yr, r), _mm_mul_ps(yg, g)), _mm_mul_ps(yb, b)), ybias));
+      _mm_storeu_ps(U+i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(ur, r), _mm_mul_ps(ug, g)), _mm_mul_ps(ub, b)));
+      _mm_storeu_ps(V+i, _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(vr, r), _mm_mul_ps(vg, g)), _mm_mul_ps(vb, b)));
+   }
+}
+
+// the sse4.1 DCT with all 8 columns in one vector
+STBIW__AVX2_TARGET
+static void stbiw__jpg_DCT_avx2(__m256 *d) {
+   const __m256 c4 = _mm256_set1_ps(0.707106781f), c6 = _mm256_set1_ps(0.382683433f);
+   const __m256 c2mc6 = _mm256_set1_ps(0.541196100f), c2pc6 = _mm256_set1_ps(1.306562965f);
+   __m256 z1, z2, z3, z4, z5, z11, z13;
+
+   __m256 tmp0 = _mm256_add_ps(d[0], d[7]);
+   __m256 tmp7 = _mm256_sub_ps(d[0], d[7]);
+   __m256 tmp1 = _mm256_add_ps(d[1], d[6]);
+   __m256 tmp6 = _mm256_sub_ps(d[1], d[6]);
+   __m256 tmp2 = _mm256_add_ps(d[2], d[5]);
+   __m256 tmp5 = _mm256_sub_ps(d[2], d[5]);
+   __m256 tmp3 = _mm256_add_ps(d[3], d[4]);
+   __m256 tmp4 = _mm256_sub_ps(d[3], d[4]);
+
+   // Even part
+   __m256 tmp10 = _mm256_add_ps(tmp0, tmp3);
+   __m256 tmp13 = _mm256_sub_ps(tmp0, tmp3);
+   __m256 tmp11 = _mm256_add_ps(tmp1, tmp2);
+   __m256 tmp12 = _mm256_sub_ps(tmp1, tmp2);
+
+   d[0] = _mm256_add_ps(tmp10, tmp11);
+   d[4] = _mm256_sub_ps(tmp10, tmp11);
+
+   z1 = _mm256_mul_ps(_mm256_add_ps(tmp12, tmp13), c4);
+   d[2] = _mm256_add_ps(tmp13, z1);
+   d[6] = _mm256_sub_ps(tmp13, z1);
+
+   // Odd part
+   tmp10 = _mm256_add_ps(tmp4, tmp5);
+   tmp11 = _mm256_add_ps(tmp5, tmp6);
+   tmp12 = _mm256_add_ps(tmp6, tmp7);
+
+   z5 = _mm256_mul_ps(_mm256_sub_ps(tmp10, tmp12), c6);
+   z2 = _mm256_add_ps(_mm256_mul_ps(tmp10, c2mc6), z5);
+   z4 = _mm256_add_ps(_mm256_mul_ps(tmp12, c2pc6), z5);
+   z3 = _mm256_mul_ps(tmp11, c4);
+
+   z11 = _mm256_add_ps(tmp7, z3);
+   z13 = _mm256_sub_ps(tmp7, z3);
+
+   d[5] = _mm256_add_ps(z13, z2);
+   d[3] = _mm256_sub_ps(z13, z2);
+   d[1] = _mm256_add_ps(z11, z4);
+   d[7] = _mm256_sub_ps(z11, z4);
+}
+
+STBIW__AVX2_TARGET
+static void stbiw__jpg_transpose_avx2(__m256 *r) {
+   __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+   __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+   __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+   __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+   __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44), s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+   __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44), s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+   __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44), s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+   __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44), s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+   r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+   r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+   r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+   r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+   r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+   r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+   r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+   r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+STBIW__AVX2_TARGET
+static void stbiw__jpg_fdct_quant_avx2(float *CDU, int du_stride, const float *fdtbl, int *DU) {
+   __m256 r[8];
+   const __m256 sign = _mm256_set1_ps(-0.0f), half = _mm256_set1_ps(0.5f);
+   int i, q[64];
+
+   for(i = 0; i < 8; ++i) {
+      r[i] = _mm256_loadu_ps(CDU + i*du_stride);
+   }
+   // rows, then columns
+   stbiw__jpg_transpose_avx2(r);
+   stbiw__jpg_DCT_avx2(r);
+   stbiw__jpg_transpose_avx2(r);
+   stbiw__jpg_DCT_avx2(r);
+
+   for(i = 0; i < 8; ++i) {
+      __m256 v = _mm256_mul_ps(r[i], _mm256_loadu_ps(fdtbl + i*8));
+      v = _mm256_add_ps(v, _mm256_or_ps(_mm256_and_ps(v, sign), half));
+      _mm256_storeu_si256((__m256i *) (q + i*8), _mm256_cvttps_epi32(v));
+   }
+   for(i = 0; i < 64; ++i) {
+      DU[stbiw__jpg_ZigZag[i]] = q[i];
+   }
+}
+
+// n must be a multiple of 8
+STBIW__AVX2_TARGET
+static void stbiw__jpg_color_avx2(float *Y, float *U, float *V, const unsigned char *p, int comp, int n) {
+   const __m256i mask = _mm256_set1_epi32(0xff);
+   const __m256i rgb_to_32 = _mm256_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1,
+                                              0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1);
+   const __m256 yr = _mm256_set1_ps(0.29900f), yg = _mm256_set1_ps(0.58700f), yb = _mm256_set1_ps(0.11400f), ybias = _mm256_set1_ps(128.0f);
+   const __m256 ur = _mm256_set1_ps(-0.16874f), ug = _mm256_set1_ps(0.33126f), ub = _mm256_set1_ps(0.50000f);
+   const __m256 vr = _mm256_set1_ps(0.50000f), vg = _mm256_set1_ps(0.41869f), vb = _mm256_set1_ps(0.08131f);
+   int i;
+
+   for(i = 0; i < n; i += 8, p += 8*comp) {
+      __m256i ri, gi, bi;
+      __m256 r, g, b;
+      if(comp >= 3) {
+         __m256i px;
+         if(comp == 4) {
+            px = _mm256_loadu_si256((const __m256i *) p);
+         } else {
+            // pixels 0-3 and 4-7 go to separate lanes; loads stay within the 24 bytes
+            int last0, last1;
+            __m128i p0, p1;
+            STBIW_MEMMOVE(&last0, p + 8, 4);
+            STBIW_MEMMOVE(&last1, p + 20, 4);
+            p0 = _mm_insert_epi32(_mm_loadl_epi64((const __m128i *) p), last0, 2);
+            p1 = _mm_insert_epi32(_mm_loadl_epi64((const __m128i *) (p + 12)), last1, 2);
+            px = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(p0), p1, 1), rgb_to_32);
+         }
+         ri = _mm256_and_si256(px, mask);
+         gi = _mm256_and_si256(_mm256_srli_epi32(px, 8), mask);
+         bi = _mm256_and_si256(_mm256_srli_epi32(px, 16), mask);
+      } else {
+         // grey or grey+alpha: r = g = b
+         if(comp == 1) {
+            ri = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) p));
+         } else {
+            ri = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) p)), mask);
+         }
+         gi = bi = ri;
+      }
+      r = _mm256_cvtepi32_ps(ri);
+      g = _mm256_cvtepi32_ps(gi);
+      b = _mm256_cvtepi32_ps(bi);
+      _mm256_storeu_ps(Y+i, _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(yr, r), _mm256_mul_ps(yg, g)), _mm256_mul_ps(yb, b)), ybias));
+      _mm256_storeu_ps(U+i, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(ur, r), _mm256_mul_ps(ug, g)), _mm256_mul_ps(ub, b)));
+      _mm256_storeu_ps(V+i, _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(vr, r), _mm256_mul_ps(vg, g)), _mm256_mul_ps(vb, b)));
+   }
+}
+#endif // STBIW_SIMD
+
+static int stbiw__jpg_processDU(stbi__write_context *s, int *bitBuf, int *bitCnt, stbiw__jpg_fdct_func *fdct, float *CDU, int du_stride, const float *fdtbl, int DC, const unsigned short HTDC[256][2], const unsigned short HTAC[256][2]) {
+   const unsigned short EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
+   const unsigned short M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
+   int i, diff, end0pos;
+   int DU[64];
+
+   fdct(CDU, du_stride, fdtbl, DU);
 
    // Encode DC
    diff = DU[0] - DC;
@@ -1395,83 +1777,94 @@ static int stbiw__jpg_processDU(stbi__write_context *s, int *bitBuf, int *bitCnt
    return DU[0];
 }
 
-static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, int comp, const void* data, int quality) {
-   // Constants that don't pollute global namespace
-   static const unsigned char std_dc_luminance_nrcodes[] = {0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
-   static const unsigned char std_dc_luminance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
-   static const unsigned char std_ac_luminance_nrcodes[] = {0,0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d};
-   static const unsigned char std_ac_luminance_values[] = {
-      0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,
-      0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
-      0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
-      0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
-      0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,
-      0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
-      0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
-   };
-   static const unsigned char std_dc_chrominance_nrcodes[] = {0,0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0};
-   static const unsigned char std_dc_chrominance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
-   static const unsigned char std_ac_chrominance_nrcodes[] = {0,0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77};
-   static const unsigned char std_ac_chrominance_values[] = {
-      0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,
-      0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
-      0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,
-      0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
-      0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,
-      0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
-      0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
-   };
-   // Huffman tables
-   static const unsigned short YDC_HT[256][2] = { {0,2},{2,3},{3,3},{4,3},{5,3},{6,3},{14,4},{30,5},{62,6},{126,7},{254,8},{510,9}};
-   static const unsigned short UVDC_HT[256][2] = { {0,2},{1,2},{2,2},{6,3},{14,4},{30,5},{62,6},{126,7},{254,8},{510,9},{1022,10},{2046,11}};
-   static const unsigned short YAC_HT[256][2] = {
-      {10,4},{0,2},{1,2},{4,3},{11,4},{26,5},{120,7},{248,8},{1014,10},{65410,16},{65411,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {12,4},{27,5},{121,7},{502,9},{2038,11},{65412,16},{65413,16},{65414,16},{65415,16},{65416,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {28,5},{249,8},{1015,10},{4084,12},{65417,16},{65418,16},{65419,16},{65420,16},{65421,16},{65422,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {58,6},{503,9},{4085,12},{65423,16},{65424,16},{65425,16},{65426,16},{65427,16},{65428,16},{65429,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {59,6},{1016,10},{65430,16},{65431,16},{65432,16},{65433,16},{65434,16},{65435,16},{65436,16},{65437,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {122,7},{2039,11},{65438,16},{65439,16},{65440,16},{65441,16},{65442,16},{65443,16},{65444,16},{65445,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {123,7},{4086,12},{65446,16},{65447,16},{65448,16},{65449,16},{65450,16},{65451,16},{65452,16},{65453,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {250,8},{4087,12},{65454,16},{65455,16},{65456,16},{65457,16},{65458,16},{65459,16},{65460,16},{65461,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {504,9},{32704,15},{65462,16},{65463,16},{65464,16},{65465,16},{65466,16},{65467,16},{65468,16},{65469,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {505,9},{65470,16},{65471,16},{65472,16},{65473,16},{65474,16},{65475,16},{65476,16},{65477,16},{65478,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {506,9},{65479,16},{65480,16},{65481,16},{65482,16},{65483,16},{65484,16},{65485,16},{65486,16},{65487,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {1017,10},{65488,16},{65489,16},{65490,16},{65491,16},{65492,16},{65493,16},{65494,16},{65495,16},{65496,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {1018,10},{65497,16},{65498,16},{65499,16},{65500,16},{65501,16},{65502,16},{65503,16},{65504,16},{65505,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {2040,11},{65506,16},{65507,16},{65508,16},{65509,16},{65510,16},{65511,16},{65512,16},{65513,16},{65514,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {65515,16},{65516,16},{65517,16},{65518,16},{65519,16},{65520,16},{65521,16},{65522,16},{65523,16},{65524,16},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {2041,11},{65525,16},{65526,16},{65527,16},{65528,16},{65529,16},{65530,16},{65531,16},{65532,16},{65533,16},{65534,16},{0,0},{0,0},{0,0},{0,0},{0,0}
-   };
-   static const unsigned short UVAC_HT[256][2] = {
-      {0,2},{1,2},{4,3},{10,4},{24,5},{25,5},{56,6},{120,7},{500,9},{1014,10},{4084,12},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {11,4},{57,6},{246,8},{501,9},{2038,11},{4085,12},{65416,16},{65417,16},{65418,16},{65419,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {26,5},{247,8},{1015,10},{4086,12},{32706,15},{65420,16},{65421,16},{65422,16},{65423,16},{65424,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {27,5},{248,8},{1016,10},{4087,12},{65425,16},{65426,16},{65427,16},{65428,16},{65429,16},{65430,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {58,6},{502,9},{65431,16},{65432,16},{65433,16},{65434,16},{65435,16},{65436,16},{65437,16},{65438,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {59,6},{1017,10},{65439,16},{65440,16},{65441,16},{65442,16},{65443,16},{65444,16},{65445,16},{65446,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {121,7},{2039,11},{65447,16},{65448,16},{65449,16},{65450,16},{65451,16},{65452,16},{65453,16},{65454,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {122,7},{2040,11},{65455,16},{65456,16},{65457,16},{65458,16},{65459,16},{65460,16},{65461,16},{65462,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {249,8},{65463,16},{65464,16},{65465,16},{65466,16},{65467,16},{65468,16},{65469,16},{65470,16},{65471,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {503,9},{65472,16},{65473,16},{65474,16},{65475,16},{65476,16},{65477,16},{65478,16},{65479,16},{65480,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {504,9},{65481,16},{65482,16},{65483,16},{65484,16},{65485,16},{65486,16},{65487,16},{65488,16},{65489,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {505,9},{65490,16},{65491,16},{65492,16},{65493,16},{65494,16},{65495,16},{65496,16},{65497,16},{65498,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {506,9},{65499,16},{65500,16},{65501,16},{65502,16},{65503,16},{65504,16},{65505,16},{65506,16},{65507,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {2041,11},{65508,16},{65509,16},{65510,16},{65511,16},{65512,16},{65513,16},{65514,16},{65515,16},{65516,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {16352,14},{65517,16},{65518,16},{65519,16},{65520,16},{65521,16},{65522,16},{65523,16},{65524,16},{65525,16},{0,0},{0,0},{0,0},{0,0},{0,0},
-      {1018,10},{32707,15},{65526,16},{65527,16},{65528,16},{65529,16},{65530,16},{65531,16},{65532,16},{65533,16},{65534,16},{0,0},{0,0},{0,0},{0,0},{0,0}
-   };
-   static const int YQT[] = {16,11,10,16,24,40,51,61,12,12,14,19,26,58,60,55,14,13,16,24,40,57,69,56,14,17,22,29,51,87,80,62,18,22,
-                             37,56,68,109,103,77,24,35,55,64,81,104,113,92,49,64,78,87,103,121,120,101,72,92,95,98,112,100,103,99};
-   static const int UVQT[] = {17,18,24,47,99,99,99,99,18,21,26,66,99,99,99,99,24,26,56,99,99,99,99,99,47,66,99,99,99,99,99,99,
-                              99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99};
-   static const float aasf[] = { 1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f,
-                                 1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f };
+static const unsigned char stbiw__jpg_std_dc_luminance_nrcodes[] = {0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
+static const unsigned char stbiw__jpg_std_dc_luminance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
+static const unsigned char stbiw__jpg_std_ac_luminance_nrcodes[] = {0,0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d};
+static const unsigned char stbiw__jpg_std_ac_luminance_values[] = {
+   0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,
+   0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
+   0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
+   0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+   0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,
+   0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
+   0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+static const unsigned char stbiw__jpg_std_dc_chrominance_nrcodes[] = {0,0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0};
+static const unsigned char stbiw__jpg_std_dc_chrominance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
+static const unsigned char stbiw__jpg_std_ac_chrominance_nrcodes[] = {0,0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77};
+static const unsigned char stbiw__jpg_std_ac_chrominance_values[] = {
+   0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,
+   0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
+   0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,
+   0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+   0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,
+   0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
+   0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+// Huffman tables
+static const unsigned short stbiw__jpg_YDC_HT[256][2] = { {0,2},{2,3},{3,3},{4,3},{5,3},{6,3},{14,4},{30,5},{62,6},{126,7},{254,8},{510,9}};
+static const unsigned short stbiw__jpg_UVDC_HT[256][2] = { {0,2},{1,2},{2,2},{6,3},{14,4},{30,5},{62,6},{126,7},{254,8},{510,9},{1022,10},{2046,11}};
+static const unsigned short stbiw__jpg_YAC_HT[256][2] = {
+   {10,4},{0,2},{1,2},{4,3},{11,4},{26,5},{120,7},{248,8},{1014,10},{65410,16},{65411,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {12,4},{27,5},{121,7},{502,9},{2038,11},{65412,16},{65413,16},{65414,16},{65415,16},{65416,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {28,5},{249,8},{1015,10},{4084,12},{65417,16},{65418,16},{65419,16},{65420,16},{65421,16},{65422,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {58,6},{503,9},{4085,12},{65423,16},{65424,16},{65425,16},{65426,16},{65427,16},{65428,16},{65429,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {59,6},{1016,10},{65430,16},{65431,16},{65432,16},{65433,16},{65434,16},{65435,16},{65436,16},{65437,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {122,7},{2039,11},{65438,16},{65439,16},{65440,16},{65441,16},{65442,16},{65443,16},{65444,16},{65445,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {123,7},{4086,12},{65446,16},{65447,16},{65448,16},{65449,16},{65450,16},{65451,16},{65452,16},{65453,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {250,8},{4087,12},{65454,16},{65455,16},{65456,16},{65457,16},{65458,16},{65459,16},{65460,16},{65461,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {504,9},{32704,15},{65462,16},{65463,16},{65464,16},{65465,16},{65466,16},{65467,16},{65468,16},{65469,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {505,9},{65470,16},{65471,16},{65472,16},{65473,16},{65474,16},{65475,16},{65476,16},{65477,16},{65478,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {506,9},{65479,16},{65480,16},{65481,16},{65482,16},{65483,16},{65484,16},{65485,16},{65486,16},{65487,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {1017,10},{65488,16},{65489,16},{65490,16},{65491,16},{65492,16},{65493,16},{65494,16},{65495,16},{65496,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {1018,10},{65497,16},{65498,16},{65499,16},{65500,16},{65501,16},{65502,16},{65503,16},{65504,16},{65505,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {2040,11},{65506,16},{65507,16},{65508,16},{65509,16},{65510,16},{65511,16},{65512,16},{65513,16},{65514,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {65515,16},{65516,16},{65517,16},{65518,16},{65519,16},{65520,16},{65521,16},{65522,16},{65523,16},{65524,16},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {2041,11},{65525,16},{65526,16},{65527,16},{65528,16},{65529,16},{65530,16},{65531,16},{65532,16},{65533,16},{65534,16},{0,0},{0,0},{0,0},{0,0},{0,0}
+};
+static const unsigned short stbiw__jpg_UVAC_HT[256][2] = {
+   {0,2},{1,2},{4,3},{10,4},{24,5},{25,5},{56,6},{120,7},{500,9},{1014,10},{4084,12},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {11,4},{57,6},{246,8},{501,9},{2038,11},{4085,12},{65416,16},{65417,16},{65418,16},{65419,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {26,5},{247,8},{1015,10},{4086,12},{32706,15},{65420,16},{65421,16},{65422,16},{65423,16},{65424,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {27,5},{248,8},{1016,10},{4087,12},{65425,16},{65426,16},{65427,16},{65428,16},{65429,16},{65430,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {58,6},{502,9},{65431,16},{65432,16},{65433,16},{65434,16},{65435,16},{65436,16},{65437,16},{65438,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {59,6},{1017,10},{65439,16},{65440,16},{65441,16},{65442,16},{65443,16},{65444,16},{65445,16},{65446,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {121,7},{2039,11},{65447,16},{65448,16},{65449,16},{65450,16},{65451,16},{65452,16},{65453,16},{65454,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {122,7},{2040,11},{65455,16},{65456,16},{65457,16},{65458,16},{65459,16},{65460,16},{65461,16},{65462,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {249,8},{65463,16},{65464,16},{65465,16},{65466,16},{65467,16},{65468,16},{65469,16},{65470,16},{65471,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {503,9},{65472,16},{65473,16},{65474,16},{65475,16},{65476,16},{65477,16},{65478,16},{65479,16},{65480,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {504,9},{65481,16},{65482,16},{65483,16},{65484,16},{65485,16},{65486,16},{65487,16},{65488,16},{65489,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {505,9},{65490,16},{65491,16},{65492,16},{65493,16},{65494,16},{65495,16},{65496,16},{65497,16},{65498,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {506,9},{65499,16},{65500,16},{65501,16},{65502,16},{65503,16},{65504,16},{65505,16},{65506,16},{65507,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {2041,11},{65508,16},{65509,16},{65510,16},{65511,16},{65512,16},{65513,16},{65514,16},{65515,16},{65516,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {16352,14},{65517,16},{65518,16},{65519,16},{65520,16},{65521,16},{65522,16},{65523,16},{65524,16},{65525,16},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {1018,10},{32707,15},{65526,16},{65527,16},{65528,16},{65529,16},{65530,16},{65531,16},{65532,16},{65533,16},{65534,16},{0,0},{0,0},{0,0},{0,0},{0,0}
+};
+static const int stbiw__jpg_YQT[] = {16,11,10,16,24,40,51,61,12,12,14,19,26,58,60,55,14,13,16,24,40,57,69,56,14,17,22,29,51,87,80,62,18,22,
+                          37,56,68,109,103,77,24,35,55,64,81,104,113,92,49,64,78,87,103,121,120,101,72,92,95,98,112,100,103,99};
+static const int stbiw__jpg_UVQT[] = {17,18,24,47,99,99,99,99,18,21,26,66,99,99,99,99,24,26,56,99,99,99,99,99,47,66,99,99,99,99,99,99,
+                           99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99};
+static const float stbiw__jpg_aasf[] = { 1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f,
+                              1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f };
 
-   int row, col, i, k, subsample;
+
+typedef struct
+{
+   int width, height, comp, subsample;
+   const unsigned char *data;
    float fdtbl_Y[64], fdtbl_UV[64];
    unsigned char YTable[64], UVTable[64];
+   stbiw__jpg_fdct_func *fdct;
+   stbiw__jpg_color_func *color;
+   const stbi_write_jpg_planes *planes; // used instead of data when set
+} stbiw__jpg_state;
+
+static int stbiw__jpg_init(stbiw__jpg_state *st, int width, int height, int comp, const void* data, int quality) {
+   int row, col, i, k, subsample;
+   float *fdtbl_Y = st->fdtbl_Y, *fdtbl_UV = st->fdtbl_UV;
+   unsigned char *YTable = st->YTable, *UVTable = st->UVTable;
 
-   if(!data || !width || !height || comp > 4 || comp < 1) {
+   if(!width || !height || comp > 4 || comp < 1) {
       return 0;
    }
 
@@ -1481,81 +1874,186 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
    quality = quality < 50 ? 5000 / quality : 200 - quality * 2;
 
    for(i = 0; i < 64; ++i) {
-      int uvti, yti = (YQT[i]*quality+50)/100;
+      int uvti, yti = (stbiw__jpg_YQT[i]*quality+50)/100;
       YTable[stbiw__jpg_ZigZag[i]] = (unsigned char) (yti < 1 ? 1 : yti > 255 ? 255 : yti);
-      uvti = (UVQT[i]*quality+50)/100;
+      uvti = (stbiw__jpg_UVQT[i]*quality+50)/100;
       UVTable[stbiw__jpg_ZigZag[i]] = (unsigned char) (uvti < 1 ? 1 : uvti > 255 ? 255 : uvti);
    }
 
    for(row = 0, k = 0; row < 8; ++row) {
       for(col = 0; col < 8; ++col, ++k) {
-         fdtbl_Y[k]  = 1 / (YTable [stbiw__jpg_ZigZag[k]] * aasf[row] * aasf[col]);
-         fdtbl_UV[k] = 1 / (UVTable[stbiw__jpg_ZigZag[k]] * aasf[row] * aasf[col]);
+         fdtbl_Y[k]  = 1 / (YTable [stbiw__jpg_ZigZag[k]] * stbiw__jpg_aasf[row] * stbiw__jpg_aasf[col]);
+         fdtbl_UV[k] = 1 / (UVTable[stbiw__jpg_ZigZag[k]] * stbiw__jpg_aasf[row] * stbiw__jpg_aasf[col]);
       }
    }
 
-   // Write Headers
+   st->width = width;
+   st->height = height;
+   st->comp = comp;
+   st->subsample = subsample;
+   st->data = (const unsigned char *)data;
+   st->planes = NULL;
+
+   st->fdct = stbiw__jpg_fdct_quant;
+   st->color = stbiw__jpg_color;
+#ifdef STBIW_SIMD
+   switch (stbiw__simd_level()) {
+      case 2:
+         st->fdct = stbiw__jpg_fdct_quant_avx2;
+         st->color = stbiw__jpg_color_avx2;
+         break;
+      case 1:
+         st->fdct = stbiw__jpg_fdct_quant_sse41;
+         st->color = stbiw__jpg_color_sse41;
+         break;
+   }
+#endif
+   return 1;
+}
+
+// restart_interval > 0 writes a DRI segment; the caller then emits RSTn markers between intervals
+static void stbiw__jpg_write_headers(stbi__write_context *s, const stbiw__jpg_state *st, int restart_interval) {
+   int width = st->width, height = st->height, subsample = st->subsample;
+   const unsigned char *YTable = st->YTable, *UVTable = st->UVTable;
    {
       static const unsigned char head0[] = { 0xFF,0xD8,0xFF,0xE0,0,0x10,'J','F','I','F',0,1,1,0,0,1,0,1,0,0,0xFF,0xDB,0,0x84,0 };
       static const unsigned char head2[] = { 0xFF,0xDA,0,0xC,3,1,0,2,0x11,3,0x11,0,0x3F,0 };
       const unsigned char head1[] = { 0xFF,0xC0,0,0x11,8,(unsigned char)(height>>8),STBIW_UCHAR(height),(unsigned char)(width>>8),STBIW_UCHAR(width),
                                       3,1,(unsigned char)(subsample?0x22:0x11),0,2,0x11,1,3,0x11,1,0xFF,0xC4,0x01,0xA2,0 };
       s->func(s->context, (void*)head0, sizeof(head0));
-      s->func(s->context, (void*)YTable, sizeof(YTable));
+      s->func(s->context, (void*)YTable, 64);
       stbiw__putc(s, 1);
-      s->func(s->context, UVTable, sizeof(UVTable));
+      s->func(s->context, (void*)UVTable, 64);
       s->func(s->context, (void*)head1, sizeof(head1));
-      s->func(s->context, (void*)(std_dc_luminance_nrcodes+1), sizeof(std_dc_luminance_nrcodes)-1);
-      s->func(s->context, (void*)std_dc_luminance_values, sizeof(std_dc_luminance_values));
+      s->func(s->context, (void*)(stbiw__jpg_std_dc_luminance_nrcodes+1), sizeof(stbiw__jpg_std_dc_luminance_nrcodes)-1);
+      s->func(s->context, (void*)stbiw__jpg_std_dc_luminance_values, sizeof(stbiw__jpg_std_dc_luminance_values));
       stbiw__putc(s, 0x10); // HTYACinfo
-      s->func(s->context, (void*)(std_ac_luminance_nrcodes+1), sizeof(std_ac_luminance_nrcodes)-1);
-      s->func(s->context, (void*)std_ac_luminance_values, sizeof(std_ac_luminance_values));
+      s->func(s->context, (void*)(stbiw__jpg_std_ac_luminance_nrcodes+1), sizeof(stbiw__jpg_std_ac_luminance_nrcodes)-1);
+      s->func(s->context, (void*)stbiw__jpg_std_ac_luminance_values, sizeof(stbiw__jpg_std_ac_luminance_values));
       stbiw__putc(s, 1); // HTUDCinfo
-      s->func(s->context, (void*)(std_dc_chrominance_nrcodes+1), sizeof(std_dc_chrominance_nrcodes)-1);
-      s->func(s->context, (void*)std_dc_chrominance_values, sizeof(std_dc_chrominance_values));
+      s->func(s->context, (void*)(stbiw__jpg_std_dc_chrominance_nrcodes+1), sizeof(stbiw__jpg_std_dc_chrominance_nrcodes)-1);
+      s->func(s->context, (void*)stbiw__jpg_std_dc_chrominance_values, sizeof(stbiw__jpg_std_dc_chrominance_values));
       stbiw__putc(s, 0x11); // HTUACinfo
-      s->func(s->context, (void*)(std_ac_chrominance_nrcodes+1), sizeof(std_ac_chrominance_nrcodes)-1);
-      s->func(s->context, (void*)std_ac_chrominance_values, sizeof(std_ac_chrominance_values));
+      s->func(s->context, (void*)(stbiw__jpg_std_ac_chrominance_nrcodes+1), sizeof(stbiw__jpg_std_ac_chrominance_nrcodes)-1);
+      s->func(s->context, (void*)stbiw__jpg_std_ac_chrominance_values, sizeof(stbiw__jpg_std_ac_chrominance_values));
+      if (restart_interval > 0) {
+         const unsigned char dri[] = { 0xFF,0xDD,0,4,(unsigned char)(restart_interval>>8),STBIW_UCHAR(restart_interval) };
+         s->func(s->context, (void*)dri, sizeof(dri));
+      }
       s->func(s->context, (void*)head2, sizeof(head2));
    }
+}
+
+// copies the n pixels left in a row and repeats the last one up to the block width
+static const unsigned char *stbiw__jpg_pad_row(unsigned char *edge, const unsigned char *p, int comp, int n, int block) {
+   int i;
+   for(i = 0; i < block; ++i) {
+      STBIW_MEMMOVE(edge + i*comp, p + (i < n ? i : n-1)*comp, comp);
+   }
+   return edge;
+}
+
+// Finds the two chroma samples bracketing full-resolution coordinate p along an axis
+// subsampled by shift, with the weight of the nearer one (the decoder's 3:1 triangle filter)
+static float stbiw__jpg_chroma_taps(int p, int shift, int n, int *near_i, int *far_i) {
+   int c = p >> shift, f;
+   if (!shift) { *near_i = *far_i = c; return 1.0f; }
+   f = (p & 1) ? c+1 : c-1;
+   *near_i = c;
+   *far_i = f < 0 ? 0 : (f >= n ? n-1 : f);
+   return 0.75f;
+}
+
+// Reads one MCU from YCbCr planes: a size x size luma block at (x, y) and an
+// 8x8 chroma block. For size 16 each chroma sample averages the 2x2 pixels it
+// covers; for size 8 subsampled chroma is interpolated back to full resolution.
+static void stbiw__jpg_planar_mcu(const stbiw__jpg_state *st, int x, int y, int size, float *Y, float *U, float *V) {
+   const stbi_write_jpg_planes *pl = st->planes;
+   int width = st->width, height = st->height, e = size / 8;
+   int cw = (width + (1 << pl->chroma_shift_x) - 1) >> pl->chroma_shift_x;
+   int ch = (height + (1 << pl->chroma_shift_y) - 1) >> pl->chroma_shift_y;
+   int row, col, pos, dx, dy;
+   for(row = 0, pos = 0; row < size; ++row) {
+      // row >= height => use last input row, col >= width => last input column
+      int py = (y+row < height) ? y+row : height-1;
+      const unsigned char *p = pl->y + (stbi__flip_vertically_on_write ? height-1-py : py) * pl->y_stride;
+      for(col = 0; col < size; ++col, ++pos) {
+         Y[pos] = p[(x+col < width) ? x+col : width-1] - 128.0f;
+      }
+   }
+   for(row = 0, pos = 0; row < 8; ++row) {
+      for(col = 0; col < 8; ++col, ++pos) {
+         float u = 0, v = 0;
+         if(pl->cb && pl->cr && e == 1) {
+            int py = (y+row < height) ? y+row : height-1;
+            int px = (x+col < width) ? x+col : width-1;
+            int y0, y1, x0, x1, i;
+            float wy = stbiw__jpg_chroma_taps(stbi__flip_vertically_on_write ? height-1-py : py, pl->chroma_shift_y, ch, &y0, &y1);
+            float wx = stbiw__jpg_chroma_taps(px, pl->chroma_shift_x, cw, &x0, &x1);
+            float w[4];
+            int ofs[4];
+            w[0] = wy*wx; w[1] = wy*(1-wx); w[2] = (1-wy)*wx; w[3] = (1-wy)*(1-wx);
+            ofs[0] = y0*pl->chroma_stride + x0; ofs[1] = y0*pl->chroma_stride + x1;
+            ofs[2] = y1*pl->chroma_stride + x0; ofs[3] = y1*pl->chroma_stride + x1;
+            for(i = 0; i < 4; ++i) {
+               u += w[i] * pl->cb[ofs[i]];
+               v += w[i] * pl->cr[ofs[i]];
+            }
+            u -= 128.0f;
+            v -= 128.0f;
+         } else if(pl->cb && pl->cr) {
+            for(dy = 0; dy < e; ++dy) {
+               int py = (y+row*e+dy < height) ? y+row*e+dy : height-1;
+               int ofs = ((stbi__flip_vertically_on_write ? height-1-py : py) >> pl->chroma_shift_y) * pl->chroma_stride;
+               for(dx = 0; dx < e; ++dx) {
+                  int px = (x+col*e+dx < width) ? x+col*e+dx : width-1;
+                  int i = ofs + (px >> pl->chroma_shift_x);
+                  u += pl->cb[i] - 128.0f;
+                  v += pl->cr[i] - 128.0f;
+               }
+            }
+            u *= 0.25f;
+            v *= 0.25f;
+         }
+         U[pos] = u;
+         V[pos] = v;
+      }
+   }
+}
 
-   // Encode 8x8 macroblocks
+// Encodes MCU rows [mcu_row_begin, mcu_row_end) with fresh DC predictors, padded to a byte boundary
+static void stbiw__jpg_write_mcu_rows(stbi__write_context *s, const stbiw__jpg_state *st, int mcu_row_begin, int mcu_row_end) {
+   int width = st->width, height = st->height, comp = st->comp, subsample = st->subsample;
+   const float *fdtbl_Y = st->fdtbl_Y, *fdtbl_UV = st->fdtbl_UV;
+   stbiw__jpg_fdct_func *fdct = st->fdct;
+   int row;
    {
       static const unsigned short fillBits[] = {0x7F, 7};
       int DCY=0, DCU=0, DCV=0;
       int bitBuf=0, bitCnt=0;
-      // comp == 2 is grey+alpha (alpha is ignored)
-      int ofsG = comp > 2 ? 1 : 0, ofsB = comp > 2 ? 2 : 0;
-      const unsigned char *dataR = (const unsigned char *)data;
-      const unsigned char *dataG = dataR + ofsG;
-      const unsigned char *dataB = dataR + ofsB;
+      const unsigned char *data = st->data;
+      unsigned char edge[16*4];
       int x, y, pos;
       if(subsample) {
-         for(y = 0; y < height; y += 16) {
+         for(y = mcu_row_begin*16; y < height && y < mcu_row_end*16; y += 16) {
             for(x = 0; x < width; x += 16) {
-               float Y[256], U[256], V[256];
-               for(row = y, pos = 0; row < y+16; ++row) {
-                  // row >= height => use last input row
-                  int clamped_row = (row < height) ? row : height - 1;
-                  int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
-                  for(col = x; col < x+16; ++col, ++pos) {
-                     // if col >= width => use pixel from last input column
-                     int p = base_p + ((col < width) ? col : (width-1))*comp;
-                     float r = dataR[p], g = dataG[p], b = dataB[p];
-                     Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
-                     U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
-                     V[pos]= +0.50000f*r - 0.41869f*g - 0.08131f*b;
-                  }
-               }
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+0,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+8,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+128, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+136, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-
-               // subsample U,V
-               {
-                  float subU[64], subV[64];
+               float Y[256], U[256], V[256], subU[64], subV[64];
+               if(st->planes) {
+                  stbiw__jpg_planar_mcu(st, x, y, 16, Y, subU, subV);
+               } else {
                   int yy, xx;
+                  for(row = y, pos = 0; row < y+16; ++row, pos += 16) {
+                     // row >= height => use last input row
+                     int clamped_row = (row < height) ? row : height - 1;
+                     const unsigned char *p = data + ((stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width + x)*comp;
+                     if(x+16 > width) {
+                        // if col >= width => use pixel from last input column
+                        p = stbiw__jpg_pad_row(edge, p, comp, width-x, 16);
+                     }
+                     st->color(Y+pos, U+pos, V+pos, p, comp, 16);
+                  }
+
+                  // subsample U,V
                   for(yy = 0, pos = 0; yy < 8; ++yy) {
                      for(xx = 0; xx < 8; ++xx, ++pos) {
                         int j = yy*32+xx*2;
@@ -1563,38 +2061,59 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
                         subV[pos] = (V[j+0] + V[j+1] + V[j+16] + V[j+17]) * 0.25f;
                      }
                   }
-                  DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subU, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                  DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subV, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
                }
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, Y+0,   16, fdtbl_Y, DCY, stbiw__jpg_YDC_HT, stbiw__jpg_YAC_HT);
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, Y+8,   16, fdtbl_Y, DCY, stbiw__jpg_YDC_HT, stbiw__jpg_YAC_HT);
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, Y+128, 16, fdtbl_Y, DCY, stbiw__jpg_YDC_HT, stbiw__jpg_YAC_HT);
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, Y+136, 16, fdtbl_Y, DCY, stbiw__jpg_YDC_HT, stbiw__jpg_YAC_HT);
+               DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, subU, 8, fdtbl_UV, DCU, stbiw__jpg_UVDC_HT, stbiw__jpg_UVAC_HT);
+               DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, subV, 8, fdtbl_UV, DCV, stbiw__jpg_UVDC_HT, stbiw__jpg_UVAC_HT);
             }
          }
       } else {
-         for(y = 0; y < height; y += 8) {
+         for(y = mcu_row_begin*8; y < height && y < mcu_row_end*8; y += 8) {
             for(x = 0; x < width; x += 8) {
                float Y[64], U[64], V[64];
-               for(row = y, pos = 0; row < y+8; ++row) {
-                  // row >= height => use last input row
-                  int clamped_row = (row < height) ? row : height - 1;
-                  int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
-                  for(col = x; col < x+8; ++col, ++pos) {
-                     // if col >= width => use pixel from last input column
-                     int p = base_p + ((col < width) ? col : (width-1))*comp;
-                     float r = dataR[p], g = dataG[p], b = dataB[p];
-                     Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
-                     U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
-                     V[pos]= +0.50000f*r - 0.41869f*g - 0.08131f*b;
+               if(st->planes) {
+                  stbiw__jpg_planar_mcu(st, x, y, 8, Y, U, V);
+               } else {
+                  for(row = y, pos = 0; row < y+8; ++row, pos += 8) {
+                     // row >= height => use last input row
+                     int clamped_row = (row < height) ? row : height - 1;
+                     const unsigned char *p = data + ((stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width + x)*comp;
+                     if(x+8 > width) {
+                        // if col >= width => use pixel from last input column
+                        p = stbiw__jpg_pad_row(edge, p, comp, width-x, 8);
+                     }
+                     st->color(Y+pos, U+pos, V+pos, p, comp, 8);
                   }
                }
 
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y, 8, fdtbl_Y,  DCY, YDC_HT, YAC_HT);
-               DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, U, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-               DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, V, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, Y, 8, fdtbl_Y,  DCY, stbiw__jpg_YDC_HT, stbiw__jpg_YAC_HT);
+               DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, U, 8, fdtbl_UV, DCU, stbiw__jpg_UVDC_HT, stbiw__jpg_UVAC_HT);
+               DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, fdct, V, 8, fdtbl_UV, DCV, stbiw__jpg_UVDC_HT, stbiw__jpg_UVAC_HT);
             }
          }
       }
 
       // Do the bit alignment of the EOI marker
       stbiw__jpg_writeBits(s, &bitBuf, &bitCnt, fillBits);
+      stbiw__write_flush(s);
+   }
+
+}
+
+static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, int comp, const void* data, int quality) {
+   stbiw__jpg_state st;
+
+   if(!data || !stbiw__jpg_init(&st, width, height, comp, data, quality)) {
+      return 0;
+   }
+
+   stbiw__jpg_write_headers(s, &st, 0);
+   {
+      int mcu_height = st.subsample ? 16 : 8;
+      stbiw__jpg_write_mcu_rows(s, &st, 0, (height + mcu_height - 1) / mcu_height);
    }
 
    // EOI
@@ -1611,6 +2130,66 @@ STBIWDEF int stbi_write_jpg_to_func(stbi_write_func *func, void *context, int x,
    return stbi_write_jpg_core(&s, x, y, comp, (void *) data, quality);
 }
 
+STBIWDEF int stbi_write_jpg_mcu_height(int quality)
+{
+   quality = quality ? quality : 90;
+   return quality <= 90 ? 16 : 8;
+}
+
+STBIWDEF int stbi_write_jpg_header_to_func(stbi_write_func *func, void *context, int x, int y, int comp, int quality, int restart_interval)
+{
+   stbi__write_context s = { 0 };
+   stbiw__jpg_state st;
+   if (restart_interval < 0 || restart_interval > 65535 || !stbiw__jpg_init(&st, x, y, comp, NULL, quality))
+      return 0;
+   stbi__start_write_callbacks(&s, func, context);
+   stbiw__jpg_write_headers(&s, &st, restart_interval);
+   return 1;
+}
+
+STBIWDEF int stbi_write_jpg_mcu_rows_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int quality, int mcu_row_begin, int mcu_row_end)
+{
+   stbi__write_context s = { 0 };
+   stbiw__jpg_state st;
+   if (!data || mcu_row_begin < 0 || mcu_row_end < mcu_row_begin || !stbiw__jpg_init(&st, x, y, comp, data, quality))
+      return 0;
+   stbi__start_write_callbacks(&s, func, context);
+   stbiw__jpg_write_mcu_rows(&s, &st, mcu_row_begin, mcu_row_end);
+   return 1;
+}
+
+static int stbiw__jpg_planes_valid(const stbi_write_jpg_planes *planes)
+{
+   return planes && planes->y && !planes->cb == !planes->cr
+       && (unsigned) planes->chroma_shift_x <= 1 && (unsigned) planes->chroma_shift_y <= 1;
+}
+
+STBIWDEF int stbi_write_jpg_planes_mcu_rows_to_func(stbi_write_func *func, void *context, int x, int y, const stbi_write_jpg_planes *planes, int quality, int mcu_row_begin, int mcu_row_end)
+{
+   stbi__write_context s = { 0 };
+   stbiw__jpg_state st;
+   if (!stbiw__jpg_planes_valid(planes) || mcu_row_begin < 0 || mcu_row_end < mcu_row_begin || !stbiw__jpg_init(&st, x, y, 3, NULL, quality))
+      return 0;
+   st.planes = planes;
+   stbi__start_write_callbacks(&s, func, context);
+   stbiw__jpg_write_mcu_rows(&s, &st, mcu_row_begin, mcu_row_end);
+   return 1;
+}
+
+STBIWDEF int stbi_write_jpg_planes_to_func(stbi_write_func *func, void *context, int x, int y, const stbi_write_jpg_planes *planes, int quality)
+{
+   int mcu_height = stbi_write_jpg_mcu_height(quality);
+   if (!stbiw__jpg_planes_valid(planes)
+       || !stbi_write_jpg_header_to_func(func, context, x, y, 3, quality, 0)
+       || !stbi_write_jpg_planes_mcu_rows_to_func(func, context, x, y, planes, quality, 0, (y + mcu_height - 1) / mcu_height))
+      return 0;
+   {
+      // EOI
+      unsigned char eoi[2] = { 0xFF, 0xD9 };
+      func(context, eoi, 2);
+   }
+   return 1;
+}
 
 #ifndef STBI_WRITE_NO_STDIO
 STBIWDEF int stbi_write_jpg(char const *filename, int x, int y, int comp, const void *data, int quality)